@@ -0,0 +1,49 @@
+#pragma once
+
+#include "CustomFP.hpp"
+
+namespace CustomFP {
+
+// how a complex product is formed in hardware
+enum class ComplexMul {
+    four_mult = 0,   // re = ac - bd, im = ad + bc
+    three_mult       // Gauss: k1 = c(a + b), k2 = a(d - c), k3 = b(c + d); re = k1 - k3, im = k1 + k2
+};
+
+// complex value whose parts are always representable in its format
+class Complex {
+private:
+    Format format;
+
+public:
+    double re;
+    double im;
+
+    // parts are rounded into format
+    Complex(Format format, double re = 0.0, double im = 0.0,
+            RoundingMode mode = RoundingMode::nearest_even);
+    static Complex from_bits(Format format, unsigned long long re_bits, unsigned long long im_bits);
+
+    Format get_format() const { return format; }
+    unsigned long long get_re_bits() const { return encode(re, format); }
+    unsigned long long get_im_bits() const { return encode(im, format); }
+    ExMy get_real() const;
+    ExMy get_imag() const;
+};
+
+// every product and sum is rounded into the format of a
+Complex add(const Complex& a, const Complex& b, RoundingMode mode = RoundingMode::nearest_even);
+Complex sub(const Complex& a, const Complex& b, RoundingMode mode = RoundingMode::nearest_even);
+Complex mul(const Complex& a, const Complex& b, ComplexMul algorithm = ComplexMul::four_mult,
+            RoundingMode mode = RoundingMode::nearest_even);
+
+Complex operator+(const Complex& a, const Complex& b);
+Complex operator-(const Complex& a, const Complex& b);
+Complex operator*(const Complex& a, const Complex& b);
+
+// (ar + ai i)(br + bi i) on parts already representable in format, with the
+// same rounding points as mul(); used by the batch kernels
+void complex_mul(double ar, double ai, double br, double bi, double& re, double& im,
+                 Format format, ComplexMul algorithm, RoundingMode mode);
+
+}
@@ -7,6 +7,48 @@
 #include <string>
 
 namespace CustomFP{
+
+// rounding applied when a value is stored into a narrower format
+enum class RoundingMode {
+    nearest_even = 0,
+    toward_zero,
+    toward_pos_inf,
+    toward_neg_inf
+};
+
+// bit layout of a 1-sign-bit custom float
+struct Format {
+    unsigned exponent_bits;
+    unsigned mantissa_bits;
+
+    constexpr unsigned get_total_bits() const { return 1 + exponent_bits + mantissa_bits; }
+    constexpr int get_bias() const { return (1 << (exponent_bits - 1)) - 1; }
+    constexpr bool operator==(const Format& other) const {
+        return exponent_bits == other.exponent_bits && mantissa_bits == other.mantissa_bits;
+    }
+    constexpr bool operator!=(const Format& other) const { return !(*this == other); }
+};
+
+// exact value of raw bits in the given format (mantissa_bits <= 52)
+double decode(unsigned long long raw, Format fmt);
+
+// round a double into the given format and return its raw bits
+unsigned long long encode(double value, Format fmt,
+                          RoundingMode mode = RoundingMode::nearest_even);
+
+// round a double to the nearest value representable in the format
+double round_value(double value, Format fmt,
+                   RoundingMode mode = RoundingMode::nearest_even);
+
+// round the exact sum a + b into the format; unlike round_value(a + b), the
+// part of the sum below the precision of a double still decides directed
+// rounding and ties
+double round_sum(double a, double b, Format fmt,
+                 RoundingMode mode = RoundingMode::nearest_even);
+
+// decoded value of every bit pattern for formats of at most 16 bits, else nullptr
+const double* decode_table(Format fmt);
+
 class ExMy {
 private:
     unsigned sign_bits;
@@ -43,13 +85,14 @@ public:
     constexpr unsigned get_total_bits() const {
         return sign_bits + mantissa_bits + exponent_bits;
     }
+    constexpr Format get_format() const { return Format{exponent_bits, mantissa_bits}; }
 
-    FP_status get_flag();
+    FP_status get_flag() const;
 
     std::string get_flag_str() const;
 
 
-    unsigned long long get_raw_bits();
+    unsigned long long get_raw_bits() const;
 
     void set_bits(unsigned long long raw_value);
 
@@ -60,6 +103,9 @@ public:
 };
 
 // operator base class
+//
+// Operators hold no state and never modify their inputs, so one instance
+// (or the value-returning functions below) may be shared across threads.
 class Operator {
 public:
     // check exponent alignment
@@ -68,34 +114,46 @@ public:
     // check if format matches
     bool data_format_cmp(const ExMy& a, const ExMy& b) const;
 
-    // align exponent by shifting mantissa
-    void align(ExMy* a, const ExMy* target);
+    // align exponent by shifting mantissa; modifies a only
+    void align(ExMy* a, const ExMy* target) const;
 };
 
 // multiplication
 class Multiplier : public Operator {
 public:
-    bool mul(const ExMy* a, const ExMy* b, ExMy* result);
+    bool mul(const ExMy* a, const ExMy* b, ExMy* result) const;
 };
 
 // division
 class Divider : public Operator {
 public:
-    bool divide(const ExMy* a, const ExMy* b, ExMy* result);
+    bool divide(const ExMy* a, const ExMy* b, ExMy* result) const;
 };
 
 // addition
 class Adder : public Operator {
 public:
-    bool add(ExMy* a, ExMy* b, ExMy* result);
+    bool add(const ExMy* a, const ExMy* b, ExMy* result) const;
 };
 
-// subtraction
+// subtraction, computed as a + (-b)
 class Subtractor : public Operator {
 public:
-    bool subtract(ExMy* a, ExMy* b, ExMy* result);
+    bool subtract(const ExMy* a, const ExMy* b, ExMy* result) const;
 };
 
+// value-returning forms; the result takes a's format, and an operator that
+// rejects its operands (mismatched formats) yields a NaN
+ExMy add(const ExMy& a, const ExMy& b);
+ExMy subtract(const ExMy& a, const ExMy& b);
+ExMy multiply(const ExMy& a, const ExMy& b);
+ExMy divide(const ExMy& a, const ExMy& b);
+
+inline ExMy operator+(const ExMy& a, const ExMy& b) { return add(a, b); }
+inline ExMy operator-(const ExMy& a, const ExMy& b) { return subtract(a, b); }
+inline ExMy operator*(const ExMy& a, const ExMy& b) { return multiply(a, b); }
+inline ExMy operator/(const ExMy& a, const ExMy& b) { return divide(a, b); }
+
 
 void print_fp(const ExMy& f, const char* label);
 
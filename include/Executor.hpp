@@ -0,0 +1,89 @@
+#pragma once
+
+#include "Tensor.hpp"
+#include "ThreadPool.hpp"
+#include <chrono>
+#include <mutex>
+
+namespace CustomFP {
+
+// Chunk-size tuner for a parallel_for call site that runs repeatedly.
+// Each call is timed at a trial grain. The trial doubles while throughput
+// improves by more than 5%. It then tries halving from the best grain, and
+// settles once neither direction helps. Safe to share across threads.
+class AutoGrain {
+private:
+    mutable std::mutex mutex;
+    size_t best_grain;
+    size_t trial_grain;
+    size_t min_grain;
+    size_t max_grain;
+    double best_rate;     // elements per second at best_grain, 0 before the first sample
+    bool growing;         // doubling, else halving
+    bool reversed;        // already switched direction once
+    bool settled;
+
+    void advance();
+
+public:
+    explicit AutoGrain(size_t initial = 1024, size_t min_grain = 16, size_t max_grain = size_t(1) << 20);
+
+    // grain for the next call
+    size_t next_grain() const;
+
+    // report that a call over elements took seconds at grain
+    void record(size_t grain, size_t elements, double seconds);
+
+    size_t get_grain() const;
+    bool is_settled() const;
+};
+
+// parallel_for with the grain picked, and then refined, by tuner
+void parallel_for(ThreadPool& pool, size_t begin, size_t end, AutoGrain& tuner,
+                  const std::function<void(size_t, size_t)>& body);
+
+// elements per chunk of parallel_transform without a tuner
+constexpr size_t transform_grain = 4096;
+
+namespace detail {
+
+// store an operator result into out, rounding it when its format differs
+inline void store_exmy(Tensor& out, size_t i, const ExMy& value) {
+    if (value.get_format() == out.get_format()) out.set_exmy(i, value);
+    else out.set(i, decode(value.get_raw_bits(), value.get_format()));
+}
+
+template <typename Body>
+void run_chunks(size_t count, ThreadPool& pool, AutoGrain* tuner, Body body) {
+    if (tuner) parallel_for(pool, 0, count, *tuner, body);
+    else pool.parallel_for(0, count, transform_grain, body);
+}
+
+}
+
+// out[i] = op(a[i]) over packed buffers, with op taking and returning ExMy
+// (for example a lambda over the value-returning operators). Results in
+// another format are rounded into out's format. Returns false when sizes differ.
+template <typename Op>
+bool parallel_transform(const Tensor& a, Tensor& out, Op op,
+                        ThreadPool& pool = ThreadPool::global(), AutoGrain* tuner = nullptr) {
+    if (a.size() != out.size()) return false;
+    detail::run_chunks(a.size(), pool, tuner, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) detail::store_exmy(out, i, op(a.get_exmy(i)));
+    });
+    return true;
+}
+
+// out[i] = op(a[i], b[i]), e.g. with op = [](const ExMy& x, const ExMy& y) { return x + y; }
+template <typename Op>
+bool parallel_transform(const Tensor& a, const Tensor& b, Tensor& out, Op op,
+                        ThreadPool& pool = ThreadPool::global(), AutoGrain* tuner = nullptr) {
+    if (a.size() != b.size() || a.size() != out.size()) return false;
+    detail::run_chunks(a.size(), pool, tuner, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i)
+            detail::store_exmy(out, i, op(a.get_exmy(i), b.get_exmy(i)));
+    });
+    return true;
+}
+
+}
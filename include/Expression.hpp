@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Tensor.hpp"
+#include <memory>
+
+namespace CustomFP {
+
+// lazy elementwise expression over tensors
+//
+//   auto y = round(a * b, fp16) + bias;
+//   y.eval(out);
+//
+// Nothing is computed until eval(). Each intermediate is carried as a double
+// plus its error term (about 106 bits), and is only rounded at explicit
+// round() nodes and when the result is stored into the output tensor. So
+// a * b + c over operands of up to 26 mantissa bits is rounded once, like a
+// fused multiply-add, unless the modelled hardware rounds in between. The graph is
+// compiled into a flat program and executed block by block in parallel,
+// without tensor-sized temporaries. Tensors are referenced, not copied, and
+// must outlive eval().
+class Expr {
+public:
+    enum class Op {
+        tensor = 0,
+        constant,
+        neg,
+        abs,
+        relu,
+        add,
+        sub,
+        mul,
+        div,
+        min,
+        max,
+        round
+    };
+
+    struct Node {
+        Op op;
+        const Tensor* tensor;     // Op::tensor
+        double value;             // Op::constant
+        Format format;            // Op::round
+        RoundingMode mode;        // Op::round
+        std::shared_ptr<const Node> lhs;
+        std::shared_ptr<const Node> rhs;
+    };
+
+    // leaves
+    Expr(const Tensor& tensor);
+    Expr(double value);
+
+    // interior node
+    Expr(Op op, const Expr& lhs, const Expr& rhs);
+
+    const std::shared_ptr<const Node>& get_node() const { return node; }
+
+    // evaluate into out, rounding the final value with mode; a tensor leaf is
+    // broadcast by repetition when its size divides out.size() (e.g. a
+    // per-column bias). Returns false on a size mismatch.
+    bool eval(Tensor& out, RoundingMode mode = RoundingMode::nearest_even) const;
+
+private:
+    explicit Expr(std::shared_ptr<const Node> node) : node(std::move(node)) {}
+    std::shared_ptr<const Node> node;
+
+    friend Expr round(const Expr& e, Format format, RoundingMode mode);
+};
+
+Expr operator+(const Expr& a, const Expr& b);
+Expr operator-(const Expr& a, const Expr& b);
+Expr operator*(const Expr& a, const Expr& b);
+Expr operator/(const Expr& a, const Expr& b);
+Expr operator-(const Expr& a);
+
+Expr abs(const Expr& a);
+Expr relu(const Expr& a);
+Expr min(const Expr& a, const Expr& b);
+Expr max(const Expr& a, const Expr& b);
+
+// explicit rounding point into format
+Expr round(const Expr& e, Format format, RoundingMode mode = RoundingMode::nearest_even);
+
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Complex.hpp"
+#include "Tensor.hpp"
+#include <vector>
+
+namespace CustomFP {
+
+enum class FFTRadix {
+    radix2 = 0,
+    radix4      // radix-4 stages, plus one radix-2 stage when log2(n) is odd
+};
+
+// Power-of-two decimation-in-time FFT evaluated in a custom format.
+// The twiddle factors are rounded into the format once, when the plan is
+// built. Every twiddle product and butterfly sum is then rounded, as a
+// hardware datapath would. Multiplications by +-i in radix-4 butterflies
+// are exact. Inverse transforms are unnormalized.
+class FFTPlan {
+private:
+    size_t n;
+    unsigned log2n;
+    Format format;
+    bool inverse;
+    FFTRadix radix;
+    ComplexMul algorithm;
+    RoundingMode mode;
+    std::vector<double> twiddle_re;   // w^k, k < n
+    std::vector<double> twiddle_im;
+    std::vector<size_t> bit_reverse;
+
+    void transform(double* re, double* im) const;
+    void radix2_stage(double* re, double* im, size_t half) const;
+    void radix4_stage(double* re, double* im, size_t quarter) const;
+
+public:
+    FFTPlan(size_t n, Format format, bool inverse = false, FFTRadix radix = FFTRadix::radix4,
+            ComplexMul algorithm = ComplexMul::four_mult,
+            RoundingMode mode = RoundingMode::nearest_even);
+
+    // n must be a power of two
+    bool is_valid() const { return n != 0 && (n & (n - 1)) == 0; }
+    size_t get_size() const { return n; }
+    Format get_format() const { return format; }
+
+    // in-place transform of batch consecutive length-n signals stored as
+    // split real/imaginary tensors in the plan's format; batches run in
+    // parallel, and the butterflies of a single large transform are split
+    // across threads. Returns false on an invalid plan or size mismatch.
+    bool execute(Tensor& re, Tensor& im, size_t batch = 1) const;
+
+    // same, on values that are already representable in the plan's format
+    void execute(double* re, double* im) const;
+};
+
+}
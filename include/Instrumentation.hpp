@@ -0,0 +1,67 @@
+#pragma once
+
+#include "CustomFP.hpp"
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// build with -DFLEXFLOAT_INSTRUMENT=0 to compile the hooks out entirely
+#ifndef FLEXFLOAT_INSTRUMENT
+#define FLEXFLOAT_INSTRUMENT 1
+#endif
+
+namespace CustomFP {
+
+// operation that raised an event
+enum class OpKind {
+    add = 0,
+    subtract,
+    multiply,
+    divide,
+    align,
+    convert,      // encode() of a wide value into a format
+    count
+};
+
+// numerical events worth tracking per layer
+enum class Event {
+    alignment_loss = 0,   // nonzero bits shifted out while aligning exponents
+    cancellation,         // more than half of the significand cancelled
+    overflow,             // finite operands produced inf
+    flush_to_zero,        // nonzero operands produced zero
+    subnormal,            // result is subnormal
+    nan_propagation,      // a NaN operand produced the result
+    count
+};
+
+const char* op_kind_name(OpKind op);
+const char* event_name(Event event);
+
+// aggregated counters of one (operation, result format) pair
+struct EventCounts {
+    OpKind op;
+    Format format;      // {0, 0}, "other" in JSON: formats past the first 32 of a thread
+    unsigned long long counts[static_cast<size_t>(Event::count)];
+};
+
+// Hot path. Each thread increments its own buffer with plain loads and
+// stores; the buffers are only merged when a snapshot is taken.
+void count_event(OpKind op, Format format, Event event);
+
+// sum of every thread's counters, nonzero entries only
+std::vector<EventCounts> event_snapshot();
+
+// zero all counters; call while no operator is running
+void reset_event_counters();
+
+// {"events": [{"op": "add", "format": "e5m10", "overflow": 3, ...}, ...]}
+void write_event_json(std::ostream& out);
+std::string event_json();
+
+}
+
+#if FLEXFLOAT_INSTRUMENT
+#define FLEXFLOAT_COUNT(op, format, event) ::CustomFP::count_event(op, format, event)
+#else
+#define FLEXFLOAT_COUNT(op, format, event) ((void)0)
+#endif
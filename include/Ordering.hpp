@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Tensor.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace CustomFP {
+
+// IEEE 754 total-order key: comparing keys as unsigned integers orders the
+// values as -NaN < -inf < ... < -0 < +0 < ... < +inf < +NaN
+unsigned long long to_order_key(unsigned long long raw, Format fmt);
+unsigned long long from_order_key(unsigned long long key, Format fmt);
+
+// raw-bit predicates and operations
+bool is_nan_bits(unsigned long long raw, Format fmt);
+bool total_order(unsigned long long a, unsigned long long b, Format fmt);   // totalOrder(a, b)
+bool fp_less(unsigned long long a, unsigned long long b, Format fmt);       // false if unordered
+bool fp_equal(unsigned long long a, unsigned long long b, Format fmt);      // -0 == +0, NaN != NaN
+
+// IEEE 754-2019 minimum/maximum: NaN propagates and -0 < +0
+unsigned long long fp_min(unsigned long long a, unsigned long long b, Format fmt);
+unsigned long long fp_max(unsigned long long a, unsigned long long b, Format fmt);
+unsigned long long fp_abs(unsigned long long raw, Format fmt);
+unsigned long long fp_neg(unsigned long long raw, Format fmt);
+
+// IEEE comparisons; mixed formats compare by exact value
+bool operator==(const ExMy& a, const ExMy& b);
+bool operator!=(const ExMy& a, const ExMy& b);
+bool operator<(const ExMy& a, const ExMy& b);
+bool operator<=(const ExMy& a, const ExMy& b);
+bool operator>(const ExMy& a, const ExMy& b);
+bool operator>=(const ExMy& a, const ExMy& b);
+
+// results keep the format of a; operands in different formats give a NaN,
+// as the arithmetic operators do
+ExMy min(const ExMy& a, const ExMy& b);
+ExMy max(const ExMy& a, const ExMy& b);
+ExMy abs(const ExMy& a);
+ExMy neg(const ExMy& a);
+
+// batch versions over packed tensors; false on a size or format mismatch.
+// The inner loops are branch-free over the packed element type so the
+// compiler vectorizes them.
+
+// keys at least as wide as the tensor's storage; pick the key type matching
+// get_element_bytes() to keep them as compact as the values. False when the
+// key type is narrower than the storage.
+bool batch_order_keys(const Tensor& in, std::vector<uint8_t>& keys);
+bool batch_order_keys(const Tensor& in, std::vector<uint16_t>& keys);
+bool batch_order_keys(const Tensor& in, std::vector<uint32_t>& keys);
+bool batch_order_keys(const Tensor& in, std::vector<unsigned long long>& keys);
+bool batch_less(const Tensor& a, const Tensor& b, std::vector<uint8_t>& out);
+bool batch_min(const Tensor& a, const Tensor& b, Tensor& out);
+bool batch_max(const Tensor& a, const Tensor& b, Tensor& out);
+bool batch_abs(const Tensor& in, Tensor& out);
+bool batch_neg(const Tensor& in, Tensor& out);
+
+// stable LSD radix sort of the packed values in total order, in place
+void radix_sort(Tensor& t);
+
+// indices of the k largest (or smallest) elements in total order, best
+// first; ties are broken by lower index
+std::vector<size_t> top_k(const Tensor& t, size_t k, bool largest = true);
+
+// raw bits of the element of the given rank (0 = smallest) in total order
+unsigned long long select_rank(const Tensor& t, size_t rank);
+
+// lower nearest-rank quantile, q in [0, 1]; NaNs sort to the ends as in
+// total order
+double quantile(const Tensor& t, double q);
+
+}
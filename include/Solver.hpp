@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Sparse.hpp"
+#include "Tensor.hpp"
+#include <iosfwd>
+#include <vector>
+
+namespace CustomFP {
+
+// Format of every solver kernel. Each kernel rounds its running value into
+// its format after every operation, as the matrix kernels do. Vectors live
+// in the update format between kernels.
+struct SolverConfig {
+    Format matvec{8, 23};       // sparse/dense matrix-vector accumulator
+    Format dot{8, 23};          // dot products, norms and step scalars
+    Format update{8, 23};       // axpy updates and the stored vectors
+    Format precond{8, 23};      // Jacobi preconditioner (CG)
+    Format factor{8, 23};       // LU factors and triangular solves (refinement)
+    Format residual{11, 52};    // residual b - Ax (refinement)
+    RoundingMode mode = RoundingMode::nearest_even;
+    size_t max_iterations = 1000;
+    double tolerance = 1e-6;    // on ||b - Ax|| / ||b||
+    bool jacobi = true;         // CG: scale by the inverse diagonal
+};
+
+struct SolverResult {
+    bool converged = false;
+    size_t iterations = 0;
+    std::vector<double> residual_history;   // relative residual, [0] is before the first iteration
+};
+
+// preconditioned conjugate gradient for symmetric positive definite a;
+// x holds the initial guess and receives the solution. Returns false on
+// a shape mismatch.
+bool conjugate_gradient(const CsrMatrix& a, const Tensor& b, Tensor& x, SolverResult& result,
+                        const SolverConfig& config = SolverConfig());
+
+// mixed-precision iterative refinement: a is factored once with partial
+// pivoting in the factor format, then each step computes the residual in
+// the residual format, solves for a correction with the low-precision
+// factors and applies it in the update format. a is a dense {n, n} tensor;
+// x receives the solution. Returns false on a shape mismatch or a zero pivot.
+bool iterative_refinement(const Tensor& a, const Tensor& b, Tensor& x, SolverResult& result,
+                          const SolverConfig& config = SolverConfig());
+
+// CSV: iteration,relative_residual
+void write_residual_history(std::ostream& out, const SolverResult& result);
+
+}
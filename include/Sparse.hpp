@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Tensor.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace CustomFP {
+
+// How the matrix kernels accumulate: products are exact, the running sum is
+// rounded into accumulator after every addition, and the final sum is
+// rounded into the output tensor's format.
+struct AccumulatorConfig {
+    Format accumulator;
+    RoundingMode mode = RoundingMode::nearest_even;
+};
+
+// compressed sparse rows with packed values; column indices are stored in
+// 16 bits when the matrix has at most 65536 columns, else in 32 bits
+class CsrMatrix {
+public:
+    struct Triplet {
+        size_t row;
+        size_t col;
+        double value;
+    };
+
+private:
+    size_t rows;
+    size_t cols;
+    Tensor values;
+    std::vector<size_t> row_ptr;
+    std::vector<uint16_t> col_index16;
+    std::vector<uint32_t> col_index32;
+
+    void set_col(size_t k, size_t col);
+
+public:
+    // entries are rounded into format; duplicates are summed first
+    CsrMatrix(Format format, size_t rows, size_t cols, std::vector<Triplet> entries);
+
+    // nonzeros of a {rows, cols} tensor, keeping its format
+    static CsrMatrix from_dense(const Tensor& dense);
+
+    size_t get_rows() const { return rows; }
+    size_t get_cols() const { return cols; }
+    size_t get_nnz() const { return values.size(); }
+    Format get_format() const { return values.get_format(); }
+    const Tensor& get_values() const { return values; }
+    const std::vector<size_t>& get_row_ptr() const { return row_ptr; }
+    size_t get_col(size_t k) const { return col_index16.empty() ? col_index32[k] : col_index16[k]; }
+    unsigned get_index_bytes() const { return col_index16.empty() ? 4 : 2; }
+};
+
+// N:M structured sparsity: every group of m consecutive columns of a row
+// keeps at most n values; the position of each kept value inside its group
+// is stored in ceil(log2(m)) bits of metadata (2 bits for 2:4)
+class StructuredSparseMatrix {
+private:
+    size_t rows;
+    size_t cols;
+    unsigned n;
+    unsigned m;
+    unsigned index_bits;
+    Tensor values;                  // rows * groups * n, zero padded
+    std::vector<uint8_t> metadata;  // bit-packed group positions
+
+    void set_position(size_t k, unsigned position);
+
+public:
+    // prune a {rows, cols} tensor, keeping the n largest magnitudes per group
+    StructuredSparseMatrix(const Tensor& dense, unsigned n = 2, unsigned m = 4);
+
+    size_t get_rows() const { return rows; }
+    size_t get_cols() const { return cols; }
+    unsigned get_n() const { return n; }
+    unsigned get_m() const { return m; }
+    size_t get_groups() const { return (cols + m - 1) / m; }
+    Format get_format() const { return values.get_format(); }
+    const Tensor& get_values() const { return values; }
+    size_t get_metadata_bytes() const { return metadata.size(); }
+
+    // column of kept value k, counted across rows and groups
+    size_t get_col(size_t k) const;
+};
+
+// y = A x; x has A.get_cols() elements and y has A.get_rows().
+// Rows are processed in parallel. Returns false on a shape mismatch.
+bool spmv(const CsrMatrix& a, const Tensor& x, Tensor& y, const AccumulatorConfig& config);
+bool spmv(const StructuredSparseMatrix& a, const Tensor& x, Tensor& y, const AccumulatorConfig& config);
+
+// C = A B with B of shape {A.get_cols(), n} and C of shape {A.get_rows(), n}
+bool spmm(const CsrMatrix& a, const Tensor& b, Tensor& c, const AccumulatorConfig& config);
+bool spmm(const StructuredSparseMatrix& a, const Tensor& b, Tensor& c, const AccumulatorConfig& config);
+
+}
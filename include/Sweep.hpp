@@ -0,0 +1,80 @@
+#pragma once
+
+#include "CustomFP.hpp"
+#include "ThreadPool.hpp"
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace CustomFP {
+
+// one recorded operation; inputs are the high-precision reference values
+struct WorkloadOp {
+    enum class Kind {
+        dot = 0,     // sum(a[i] * b[i]), i < n
+        gemm,        // A (m x k) * B (k x n), row-major
+        reduce       // sum(a[i]), i < n
+    };
+
+    Kind kind;
+    size_t m;
+    size_t n;
+    size_t k;
+    std::vector<double> a;
+    std::vector<double> b;
+};
+
+struct Workload {
+    std::vector<WorkloadOp> ops;
+};
+
+// text workload format, whitespace separated, '#' starts a comment:
+//   dot <n> <n values of a> <n values of b>
+//   gemm <m> <n> <k> <m*k values of A> <k*n values of B>
+//   reduce <n> <n values>
+bool load_workload(std::istream& in, Workload& workload);
+bool load_workload(const std::string& path, Workload& workload);
+
+// parse "e5m10" style format names
+bool parse_format(const std::string& name, Format& format);
+std::string format_name(Format format);
+
+// parse "rne", "rtz", "rup" or "rdn"
+bool parse_rounding(const std::string& name, RoundingMode& mode);
+std::string rounding_name(RoundingMode mode);
+
+// one point of the design space: inputs are rounded to input, products are
+// exact (kept as a double plus its fma error term, so any input width up
+// to m52 works), and every accumulation step is rounded once to accumulator
+struct SweepConfig {
+    Format input;
+    Format accumulator;
+    RoundingMode mode;
+};
+
+std::vector<SweepConfig> make_grid(const std::vector<Format>& inputs,
+                                   const std::vector<Format>& accumulators,
+                                   const std::vector<RoundingMode>& modes);
+
+struct SweepResult {
+    SweepConfig config;
+    size_t outputs;          // result elements compared
+    size_t non_finite;       // results that overflowed or became NaN
+    double max_abs_error;
+    double mean_rel_error;
+    double max_rel_error;
+    unsigned bits;           // storage bits per input element
+    double area;             // MAC area proxy relative to an fp32 MAC
+    double energy;           // energy-per-MAC proxy relative to an fp32 MAC
+};
+
+// run every config over the workload on the pool. Reference results and
+// rounded inputs are computed once and shared by all configs that need them.
+std::vector<SweepResult> run_sweep(const Workload& workload,
+                                   const std::vector<SweepConfig>& configs,
+                                   ThreadPool& pool = ThreadPool::global());
+
+// error vs. cost table, one row per config
+void write_table(std::ostream& out, const std::vector<SweepResult>& results);
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "CustomFP.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace CustomFP {
+
+// packed buffer of custom floats; each element takes the smallest of
+// 1, 2, 4 or 8 bytes that holds the format
+class Tensor {
+private:
+    Format format;
+    std::vector<size_t> shape;
+    unsigned element_bytes;
+    std::vector<uint8_t> storage;
+
+public:
+    Tensor(Format format, std::vector<size_t> shape);
+    Tensor(Format format, size_t size);
+
+    // getters
+    Format get_format() const { return format; }
+    const std::vector<size_t>& get_shape() const { return shape; }
+    unsigned get_element_bytes() const { return element_bytes; }
+    size_t size() const { return storage.size() / element_bytes; }
+
+    // raw element access
+    unsigned long long get_bits(size_t i) const;
+    void set_bits(size_t i, unsigned long long raw);
+
+    // value access, rounding on store
+    double get(size_t i) const { return decode(get_bits(i), format); }
+    void set(size_t i, double value, RoundingMode mode = RoundingMode::nearest_even) {
+        set_bits(i, encode(value, format, mode));
+    }
+
+    ExMy get_exmy(size_t i) const;
+    void set_exmy(size_t i, const ExMy& value);
+
+    // bulk conversion of [begin, end) to and from doubles
+    void decode_range(size_t begin, size_t end, double* out) const;
+    void encode_range(size_t begin, size_t end, const double* in,
+                      RoundingMode mode = RoundingMode::nearest_even);
+
+    // typed view of the packed storage; T must match get_element_bytes()
+    template <typename T> T* data() { return reinterpret_cast<T*>(storage.data()); }
+    template <typename T> const T* data() const { return reinterpret_cast<const T*>(storage.data()); }
+};
+
+// call f(T{}) with the unsigned integer type that stores one element of t
+template <typename F>
+void visit_element_type(const Tensor& t, F&& f) {
+    switch (t.get_element_bytes()) {
+        case 1: f(uint8_t{}); break;
+        case 2: f(uint16_t{}); break;
+        case 4: f(uint32_t{}); break;
+        default: f(uint64_t{}); break;
+    }
+}
+
+}
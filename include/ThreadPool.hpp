@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace CustomFP {
+
+// set of tasks that can be waited on together
+class TaskGroup {
+private:
+    std::atomic<size_t> pending{0};
+    friend class ThreadPool;
+
+public:
+    bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+};
+
+// work-stealing pool used by the batch kernels
+//
+// Every worker owns a deque: it pushes and pops its own tasks at the back
+// and steals from the front of the others when it runs dry. Tasks
+// submitted from outside the pool go to a shared injection queue. A thread
+// waiting on a group keeps executing queued tasks, so tasks may submit and
+// wait on nested work without deadlocking; with nothing left to run it
+// sleeps until new work arrives or the group finishes.
+class ThreadPool {
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;   // [0] is the injection queue
+    std::vector<std::thread> workers;
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    std::atomic<size_t> queued{0};
+    bool stopping;
+    bool pinned;
+
+    void worker_loop(size_t index);
+    size_t current_queue() const;
+    bool run_one(size_t home);
+
+public:
+    // num_threads == 0 picks the hardware concurrency; pin_threads binds
+    // worker i (1 <= i < num_threads) to the i-th CPU the process may run
+    // on (Linux only). Slot 0 is the calling thread, which keeps its own
+    // affinity: the first allowed CPU is left free for it, but the
+    // scheduler may still run it next to a worker.
+    explicit ThreadPool(unsigned num_threads = 0, bool pin_threads = false);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // number of threads that execute tasks, including a waiting caller
+    unsigned get_num_threads() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+    // whether the pool has workers and every one was bound to a core
+    bool is_pinned() const { return pinned; }
+
+    // queue a task; it is counted in group until it returns
+    void submit(TaskGroup& group, std::function<void()> task);
+
+    // run queued tasks until every task of group has finished
+    void wait(TaskGroup& group);
+
+    // run body(chunk_begin, chunk_end) over [begin, end) in chunks of at least grain
+    void parallel_for(size_t begin, size_t end, size_t grain,
+                      const std::function<void(size_t, size_t)>& body);
+
+    // process-wide pool shared by the library kernels; its workers are
+    // pinned when built with FLEXFLOAT_PIN_THREADS
+    static ThreadPool& global();
+};
+
+// parallel_for on the global pool
+void parallel_for(size_t begin, size_t end, size_t grain,
+                  const std::function<void(size_t, size_t)>& body);
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "CustomFP.hpp"
+#include "Instrumentation.hpp"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// build with -DFLEXFLOAT_TRACE=0 to compile the tracing hooks out entirely
+#ifndef FLEXFLOAT_TRACE
+#define FLEXFLOAT_TRACE 1
+#endif
+
+namespace CustomFP {
+
+// one traced operation, stored verbatim (32 bytes, host byte order)
+struct TraceRecord {
+    uint8_t op;                 // OpKind
+    uint8_t flags;              // ExMy::FP_status of the result
+    uint8_t a_exponent_bits;
+    uint8_t a_mantissa_bits;
+    uint8_t b_exponent_bits;
+    uint8_t b_mantissa_bits;
+    uint8_t result_exponent_bits;
+    uint8_t result_mantissa_bits;
+    uint64_t a;
+    uint64_t b;
+    uint64_t result;
+};
+static_assert(sizeof(TraceRecord) == 32, "trace records are written verbatim");
+
+// Trace file layout: "FFTR", uint32 version, then chunks of
+// { uint32 thread, uint32 count, count records }. Records of one thread
+// appear in execution order.
+//
+// While tracing, every operator call appends a record to its thread's
+// lock-free single-producer ring; a background thread drains the rings to
+// the file. A full ring makes the producer wait rather than drop records.
+// Start and stop tracing while no operator is running.
+bool trace_start(const std::string& path, size_t ring_records = 1 << 16);
+void trace_stop();
+
+namespace detail {
+extern std::atomic<bool> trace_active;
+}
+
+inline bool trace_enabled() {
+    return detail::trace_active.load(std::memory_order_relaxed);
+}
+
+void trace_record(const TraceRecord& record);
+
+// records the operands on entry and the result when the scope ends
+class TraceScope {
+private:
+    bool active;
+    TraceRecord record;
+    const ExMy* result;
+
+public:
+    TraceScope(OpKind op, const ExMy& a, const ExMy& b, const ExMy& result);
+    ~TraceScope();
+};
+
+// reads every record of a trace in file order
+bool read_trace(const std::string& path, std::vector<TraceRecord>& records);
+
+// recomputes the result bits of a record
+using ReplayBackend = std::function<unsigned long long(const TraceRecord&)>;
+
+// the ExMy operator classes
+ReplayBackend operator_backend();
+
+// the exact result of the decoded operands, rounded once into the result format
+ReplayBackend reference_backend(RoundingMode mode = RoundingMode::nearest_even);
+
+struct Divergence {
+    bool found;
+    size_t index;                  // record position in file order
+    uint32_t thread;
+    TraceRecord record;
+    unsigned long long replayed;   // what the backend produced instead of record.result
+};
+
+// replays the trace and reports the first record whose result differs
+// (any NaN matches any NaN); false if the file cannot be read
+bool replay_trace(const std::string& path, const ReplayBackend& backend, Divergence& divergence);
+
+}
+
+#if FLEXFLOAT_TRACE
+#define FLEXFLOAT_TRACE_SCOPE(op, a, b, result) ::CustomFP::TraceScope flexfloat_trace_scope(op, a, b, result)
+#else
+#define FLEXFLOAT_TRACE_SCOPE(op, a, b, result) ((void)0)
+#endif
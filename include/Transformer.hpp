@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Tensor.hpp"
+
+namespace CustomFP {
+
+// Fused transformer kernels over packed tensors. Each kernel works row by
+// row on the last dimension, in a per-thread buffer, and spreads the rows
+// across the global pool. Every internal rounding point is named in the
+// kernel's config. Results are rounded into the output tensor's format.
+
+struct SoftmaxConfig {
+    Format exponent{8, 23};      // x - max and exp(x - max)
+    Format accumulator{8, 23};   // running sum of the exponentials
+    bool reciprocal = false;     // multiply by 1 / sum, rounded into accumulator, instead of dividing
+    RoundingMode mode = RoundingMode::nearest_even;
+};
+
+struct NormConfig {
+    Format accumulator{8, 23};   // sums of x, (x - mean)^2 or x^2, and x - mean
+    Format statistics{8, 23};    // mean, variance, 1 / sqrt(var + eps) and the normalized value
+    Format affine{8, 23};        // gamma * normalized, then + beta
+    double epsilon = 1e-5;
+    RoundingMode mode = RoundingMode::nearest_even;
+};
+
+enum class Activation {
+    gelu_erf = 0,   // 0.5 x (1 + erf(x / sqrt(2)))
+    gelu_tanh,      // 0.5 x (1 + tanh(sqrt(2 / pi) (x + 0.044715 x^3)))
+    silu            // x / (1 + exp(-x))
+};
+
+struct ActivationConfig {
+    Format intermediate{8, 23};  // the erf / tanh argument and value, or the sigmoid
+    Format epilogue{8, 23};      // 0.5 x, 1 + erf / tanh and the final product
+    RoundingMode mode = RoundingMode::nearest_even;
+};
+
+struct AttentionConfig {
+    Format score_accumulator{8, 23};    // q . k dot products
+    Format score{8, 23};                // scaled scores
+    SoftmaxConfig softmax;
+    Format probability{8, 23};          // normalized attention weights
+    Format output_accumulator{8, 23};   // weights . v
+    double scale = 0.0;                 // 0 means 1 / sqrt(head dim)
+    bool causal = false;                // query i attends to keys j <= i + seq_k - seq_q
+    RoundingMode mode = RoundingMode::nearest_even;
+};
+
+// softmax over the last dimension, with the row maximum subtracted first
+bool softmax(const Tensor& x, Tensor& out, const SoftmaxConfig& config = SoftmaxConfig());
+
+// gamma and beta have the size of the last dimension
+bool layer_norm(const Tensor& x, const Tensor& gamma, const Tensor& beta, Tensor& out,
+                const NormConfig& config = NormConfig());
+bool rms_norm(const Tensor& x, const Tensor& gamma, Tensor& out, const NormConfig& config = NormConfig());
+
+// elementwise; x and out must have the same size
+bool activation(const Tensor& x, Tensor& out, Activation kind,
+                const ActivationConfig& config = ActivationConfig());
+
+// softmax(q k^T * scale) v per head without materializing the score matrix.
+// q is {heads, seq_q, d}, k is {heads, seq_k, d}, v is {heads, seq_k, dv}
+// and out is {heads, seq_q, dv}; 2-D tensors are a single head.
+bool attention(const Tensor& q, const Tensor& k, const Tensor& v, Tensor& out,
+               const AttentionConfig& config = AttentionConfig());
+
+}
@@ -0,0 +1,60 @@
+#include "Complex.hpp"
+
+namespace CustomFP {
+
+Complex::Complex(Format format, double re, double im, RoundingMode mode)
+    : format(format), re(round_value(re, format, mode)), im(round_value(im, format, mode)) {}
+
+Complex Complex::from_bits(Format format, unsigned long long re_bits, unsigned long long im_bits) {
+    return Complex(format, decode(re_bits, format), decode(im_bits, format));
+}
+
+ExMy Complex::get_real() const {
+    ExMy value(1, format.exponent_bits, format.mantissa_bits);
+    value.set_bits(get_re_bits());
+    return value;
+}
+
+ExMy Complex::get_imag() const {
+    ExMy value(1, format.exponent_bits, format.mantissa_bits);
+    value.set_bits(get_im_bits());
+    return value;
+}
+
+void complex_mul(double ar, double ai, double br, double bi, double& re, double& im,
+                 Format format, ComplexMul algorithm, RoundingMode mode) {
+    auto r = [&](double x) { return round_value(x, format, mode); };
+    auto add = [&](double x, double y) { return round_sum(x, y, format, mode); };
+    if (algorithm == ComplexMul::three_mult) {
+        double k1 = r(br * add(ar, ai));
+        double k2 = r(ar * add(bi, -br));
+        double k3 = r(ai * add(br, bi));
+        re = add(k1, -k3);
+        im = add(k1, k2);
+    } else {
+        re = add(r(ar * br), -r(ai * bi));
+        im = add(r(ar * bi), r(ai * br));
+    }
+}
+
+Complex add(const Complex& a, const Complex& b, RoundingMode mode) {
+    Format format = a.get_format();
+    return Complex(format, round_sum(a.re, b.re, format, mode), round_sum(a.im, b.im, format, mode), mode);
+}
+
+Complex sub(const Complex& a, const Complex& b, RoundingMode mode) {
+    Format format = a.get_format();
+    return Complex(format, round_sum(a.re, -b.re, format, mode), round_sum(a.im, -b.im, format, mode), mode);
+}
+
+Complex mul(const Complex& a, const Complex& b, ComplexMul algorithm, RoundingMode mode) {
+    double re, im;
+    complex_mul(a.re, a.im, b.re, b.im, re, im, a.get_format(), algorithm, mode);
+    return Complex(a.get_format(), re, im, mode);
+}
+
+Complex operator+(const Complex& a, const Complex& b) { return add(a, b); }
+Complex operator-(const Complex& a, const Complex& b) { return sub(a, b); }
+Complex operator*(const Complex& a, const Complex& b) { return mul(a, b); }
+
+}
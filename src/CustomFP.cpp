@@ -1,5 +1,13 @@
 #include "CustomFP.hpp"
+#include "Instrumentation.hpp"
+#include "Trace.hpp"
+#include <algorithm>
 #include <cmath>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 namespace CustomFP {
 
@@ -33,7 +41,7 @@ void ExMy::IEEE754_status_update() {
         status = FP_status::normal;
 }
 
-ExMy::FP_status ExMy::get_flag(){
+ExMy::FP_status ExMy::get_flag() const{
     return status;
 }
 
@@ -55,7 +63,7 @@ void ExMy::clamp_to_format() {
     exponent &= (1ULL << exponent_bits) - 1;
 }
 
-unsigned long long ExMy::get_raw_bits(){
+unsigned long long ExMy::get_raw_bits() const{
     unsigned long long result;
     result = ((unsigned long long)sign) << (exponent_bits + mantissa_bits);
     result |= ((exponent) << mantissa_bits);
@@ -76,6 +84,189 @@ void ExMy::set_inf() {
     IEEE754_status_update();
 }
 
+// Format conversion
+double decode(unsigned long long raw, Format fmt) {
+    unsigned long long mantissa = raw & ((1ULL << fmt.mantissa_bits) - 1);
+    unsigned long long exponent = (raw >> fmt.mantissa_bits) & ((1ULL << fmt.exponent_bits) - 1);
+    bool negative = (raw >> (fmt.mantissa_bits + fmt.exponent_bits)) & 1ULL;
+    double value;
+    if (exponent == (1ULL << fmt.exponent_bits) - 1) {
+        value = mantissa ? std::numeric_limits<double>::quiet_NaN()
+                         : std::numeric_limits<double>::infinity();
+    } else if (exponent == 0) {
+        value = std::ldexp(static_cast<double>(mantissa),
+                           1 - fmt.get_bias() - static_cast<int>(fmt.mantissa_bits));
+    } else {
+        value = std::ldexp(static_cast<double>(mantissa | (1ULL << fmt.mantissa_bits)),
+                           static_cast<int>(exponent) - fmt.get_bias() - static_cast<int>(fmt.mantissa_bits));
+    }
+    return negative ? -value : value;
+}
+
+// round a non-negative integral-scaled magnitude to an integer
+static double round_scaled(double scaled, bool negative, RoundingMode mode) {
+    double floor_value = std::floor(scaled);
+    double diff = scaled - floor_value;
+    if (diff == 0.0) return floor_value;
+    switch (mode) {
+        case RoundingMode::toward_zero: return floor_value;
+        case RoundingMode::toward_pos_inf: return negative ? floor_value : floor_value + 1.0;
+        case RoundingMode::toward_neg_inf: return negative ? floor_value + 1.0 : floor_value;
+        case RoundingMode::nearest_even:
+        default:
+            if (diff > 0.5) return floor_value + 1.0;
+            if (diff < 0.5) return floor_value;
+            return std::fmod(floor_value, 2.0) == 0.0 ? floor_value : floor_value + 1.0;
+    }
+}
+
+unsigned long long encode(double value, Format fmt, RoundingMode mode) {
+    const unsigned long long sign_bit = 1ULL << (fmt.exponent_bits + fmt.mantissa_bits);
+    const unsigned long long max_exponent = (1ULL << fmt.exponent_bits) - 1;
+    const unsigned long long implicit_bit = 1ULL << fmt.mantissa_bits;
+
+    if (std::isnan(value)) {
+        FLEXFLOAT_COUNT(OpKind::convert, fmt, Event::nan_propagation);
+        unsigned long long payload = fmt.mantissa_bits ? (implicit_bit >> 1) : 0;
+        return (max_exponent << fmt.mantissa_bits) | payload;
+    }
+
+    bool negative = std::signbit(value);
+    unsigned long long sign = negative ? sign_bit : 0;
+    double magnitude = std::fabs(value);
+    auto overflow = [&]() {
+        FLEXFLOAT_COUNT(OpKind::convert, fmt, Event::overflow);
+        bool to_inf = mode == RoundingMode::nearest_even
+                   || (mode == RoundingMode::toward_pos_inf && !negative)
+                   || (mode == RoundingMode::toward_neg_inf && negative);
+        if (to_inf) return sign | (max_exponent << fmt.mantissa_bits);
+        return sign | ((max_exponent - 1) << fmt.mantissa_bits) | (implicit_bit - 1);
+    };
+
+    if (std::isinf(magnitude)) return sign | (max_exponent << fmt.mantissa_bits);
+    if (magnitude == 0.0) return sign;
+
+    int exp2;
+    std::frexp(magnitude, &exp2);
+    long long biased = static_cast<long long>(exp2) - 1 + fmt.get_bias();
+    int mantissa_bits = static_cast<int>(fmt.mantissa_bits);
+
+    if (biased >= 1) {
+        double q = round_scaled(std::ldexp(magnitude, mantissa_bits - (exp2 - 1)), negative, mode);
+        unsigned long long scaled = static_cast<unsigned long long>(q);
+        if (scaled >> (fmt.mantissa_bits + 1)) {
+            scaled >>= 1;
+            biased += 1;
+        }
+        if (biased >= static_cast<long long>(max_exponent)) return overflow();
+        return sign | (static_cast<unsigned long long>(biased) << fmt.mantissa_bits) | (scaled - implicit_bit);
+    }
+
+    // subnormal range: fixed scale of the minimum exponent
+    double q = round_scaled(std::ldexp(magnitude, mantissa_bits - 1 + fmt.get_bias()), negative, mode);
+    unsigned long long scaled = static_cast<unsigned long long>(q);
+    if (scaled >= implicit_bit) return sign | (1ULL << fmt.mantissa_bits) | (scaled - implicit_bit);
+    FLEXFLOAT_COUNT(OpKind::convert, fmt, scaled ? Event::subnormal : Event::flush_to_zero);
+    return sign | scaled;
+}
+
+double round_value(double value, Format fmt, RoundingMode mode) {
+    return decode(encode(value, fmt, mode), fmt);
+}
+
+double round_sum(double a, double b, Format fmt, RoundingMode mode) {
+    double sum = a + b;
+    if (!std::isfinite(sum)) return round_value(sum, fmt, mode);
+    // TwoSum: sum + residual == a + b exactly
+    double b_part = sum - a;
+    double residual = (a - (sum - b_part)) + (b - b_part);
+    if (residual == 0.0) return round_value(sum, fmt, mode);
+
+    // neighbours in the format that bracket the exact sum strictly; the
+    // residual is below half an ulp of the double sum, so it never crosses a
+    // representable value other than sum itself
+    double down = round_value(sum, fmt, RoundingMode::toward_neg_inf);
+    double up = round_value(sum, fmt, RoundingMode::toward_pos_inf);
+    bool on_grid = down == up;
+    if (on_grid && residual > 0.0)
+        up = round_value(std::nextafter(sum, INFINITY), fmt, RoundingMode::toward_pos_inf);
+    else if (on_grid)
+        down = round_value(std::nextafter(sum, -INFINITY), fmt, RoundingMode::toward_neg_inf);
+
+    switch (mode) {
+        case RoundingMode::toward_pos_inf: return up;
+        case RoundingMode::toward_neg_inf: return down;
+        case RoundingMode::toward_zero: return sum > 0.0 ? down : up;
+        case RoundingMode::nearest_even:
+        default:
+            // a representable sum is nearest; a double sum exactly halfway
+            // between two values is a tie the residual breaks
+            if (on_grid) return sum;
+            if (sum - down == up - sum) return residual > 0.0 ? up : down;
+            return round_value(sum, fmt, mode);
+    }
+}
+
+// one slot per (exponent_bits, mantissa_bits) of a format of at most 16 bits;
+// a table is built once under the mutex and never freed, so every later
+// lookup is a single acquire load
+static std::atomic<const double*> decode_tables[16][16];
+
+const double* decode_table(Format fmt) {
+    if (fmt.get_total_bits() > 16) return nullptr;
+    auto& slot = decode_tables[fmt.exponent_bits][fmt.mantissa_bits];
+    const double* table = slot.load(std::memory_order_acquire);
+    if (table) return table;
+
+    static std::mutex build_mutex;
+    static std::vector<std::unique_ptr<double[]>> storage;
+    std::lock_guard<std::mutex> lock(build_mutex);
+    table = slot.load(std::memory_order_relaxed);
+    if (!table) {
+        size_t count = size_t(1) << fmt.get_total_bits();
+        storage.push_back(std::make_unique<double[]>(count));
+        for (unsigned long long raw = 0; raw < count; ++raw) storage.back()[raw] = decode(raw, fmt);
+        table = storage.back().get();
+        slot.store(table, std::memory_order_release);
+    }
+    return table;
+}
+
+// Instrumentation hooks
+#if FLEXFLOAT_INSTRUMENT
+static unsigned significant_bits(unsigned long long value) {
+    return value ? 64 - __builtin_clzll(value) : 0;
+}
+#endif
+
+// events visible from the operands and the final result status
+static void count_result_events(OpKind op, const ExMy& a, const ExMy& b, const ExMy& result) {
+#if FLEXFLOAT_INSTRUMENT
+    using Status = ExMy::FP_status;
+    Format format = result.get_format();
+    if (a.status == Status::NaN || b.status == Status::NaN) {
+        FLEXFLOAT_COUNT(op, format, Event::nan_propagation);
+        return;
+    }
+    bool finite = a.status != Status::inf && b.status != Status::inf;
+    if (finite && result.status == Status::inf) FLEXFLOAT_COUNT(op, format, Event::overflow);
+    if (result.status == Status::subnormal) FLEXFLOAT_COUNT(op, format, Event::subnormal);
+#else
+    (void)op; (void)a; (void)b; (void)result;
+#endif
+}
+
+// opposite-sign difference that lost more than half of the significand
+static void count_cancellation(OpKind op, const ExMy& result,
+                               unsigned long long larger, unsigned long long difference) {
+#if FLEXFLOAT_INSTRUMENT
+    if (significant_bits(larger) - significant_bits(difference) > result.get_mantissa_bits() / 2)
+        FLEXFLOAT_COUNT(op, result.get_format(), Event::cancellation);
+#else
+    (void)op; (void)result; (void)larger; (void)difference;
+#endif
+}
+
 // Operator base
 bool Operator::check_alignment(const ExMy& a, const ExMy& b) const {
     return a.exponent == b.exponent;
@@ -87,16 +278,36 @@ bool Operator::data_format_cmp(const ExMy& a, const ExMy& b) const {
             a.get_sign_bits() == b.get_sign_bits());
 }
 
-void Operator::align(ExMy* a, const ExMy* target) {
+// shift a's mantissa right until its exponent matches target's
+static void align_mantissa(ExMy* a, const ExMy* target) {
     if (target->exponent < a->exponent) {
         auto scale = a->exponent - target->exponent;
+        bool lost = scale >= 64 ? a->mantissa != 0 : (a->mantissa & ((1ULL << scale) - 1)) != 0;
+        if (lost) FLEXFLOAT_COUNT(OpKind::align, a->get_format(), Event::alignment_loss);
         a->mantissa >>= scale;
         a->exponent = target->exponent;
     } 
 }
 
+void Operator::align(ExMy* a, const ExMy* target) const {
+    align_mantissa(a, target);
+}
+
+// mantissa field of the quiet NaN; a format without mantissa bits has no NaN
+static unsigned long long quiet_nan_mantissa(unsigned mantissa_bits) {
+    return mantissa_bits ? 1ULL << (mantissa_bits - 1) : 0;
+}
+
+static void set_quiet_nan(ExMy* result) {
+    result->exponent = (1ULL << result->get_exponent_bits()) - 1;
+    result->mantissa = quiet_nan_mantissa(result->get_mantissa_bits());
+    result->IEEE754_status_update();
+}
+
 // Multiplier
-bool Multiplier::mul(const ExMy* a, const ExMy* b, ExMy* result) {
+bool Multiplier::mul(const ExMy* a, const ExMy* b, ExMy* result) const {
+    if (!data_format_cmp(*a, *b)) return false;
+    FLEXFLOAT_TRACE_SCOPE(OpKind::multiply, *a, *b, *result);
     if(a->status == CustomFP::ExMy::FP_status::zero || b->status == CustomFP::ExMy::FP_status::zero){
         result->sign = 0;
         result->mantissa = 0;
@@ -127,27 +338,102 @@ bool Multiplier::mul(const ExMy* a, const ExMy* b, ExMy* result) {
     result->exponent = a->exponent + b->exponent - ((1 << (a->get_exponent_bits() - 1)) - 1) + 1 - shift;
 
     result->IEEE754_status_update();
+
+#if FLEXFLOAT_INSTRUMENT
+    // exponents past the format wrap when clamped, so the status alone misses them
+    long long unbounded = static_cast<long long>(a->exponent + b->exponent)
+                        - ((1 << (a->get_exponent_bits() - 1)) - 1) + 1 - shift;
+    long long max_exponent = (1LL << result->get_exponent_bits()) - 1;
+    bool finite = a->status != ExMy::FP_status::NaN && b->status != ExMy::FP_status::NaN
+               && a->status != ExMy::FP_status::inf && b->status != ExMy::FP_status::inf;
+    if (finite) {
+        // an exact inf result is counted by count_result_events
+        if (unbounded >= max_exponent && result->status != ExMy::FP_status::inf)
+            FLEXFLOAT_COUNT(OpKind::multiply, result->get_format(), Event::overflow);
+        if (unbounded <= 0) FLEXFLOAT_COUNT(OpKind::multiply, result->get_format(), Event::flush_to_zero);
+    }
+#endif
+    count_result_events(OpKind::multiply, *a, *b, *result);
     result->clamp_to_format();
 
     return true;
 }
 
 // Divider
-bool Divider::divide(const ExMy* a, const ExMy* b, ExMy* result) {
+// significand with the implicit bit restored and its leading one moved to
+// bit mantissa_bits; subnormals are shifted up and their exponent lowered
+static uint64_t normalized_significand(const ExMy& x, long long& exponent) {
+    unsigned mantissa_bits = x.get_mantissa_bits();
+    uint64_t significand = x.mantissa;
+    if (x.exponent != 0) {
+        exponent = static_cast<long long>(x.exponent);
+        return significand | (1ULL << mantissa_bits);
+    }
+    exponent = 1;
+    while (!(significand >> mantissa_bits)) {
+        significand <<= 1;
+        --exponent;
+    }
+    return significand;
+}
+
+bool Divider::divide(const ExMy* a, const ExMy* b, ExMy* result) const {
+    if (!data_format_cmp(*a, *b)) return false;
+    FLEXFLOAT_TRACE_SCOPE(OpKind::divide, *a, *b, *result);
+    using Status = ExMy::FP_status;
+    unsigned mantissa_bits = a->get_mantissa_bits();
+    long long max_exponent = (1LL << a->get_exponent_bits()) - 1;
     result->sign = a->sign ^ b->sign;
-    result->mantissa = a->mantissa / b->mantissa;
-    result->exponent = a->exponent - b->exponent;
+
+    if (a->status == Status::NaN || b->status == Status::NaN
+        || (a->status == Status::zero && b->status == Status::zero)
+        || (a->status == Status::inf && b->status == Status::inf)) {
+        set_quiet_nan(result);
+    } else if (a->status == Status::inf || b->status == Status::zero) {
+        result->set_inf();
+    } else if (a->status == Status::zero || b->status == Status::inf) {
+        result->exponent = 0;
+        result->mantissa = 0;
+    } else {
+        long long exponent_a, exponent_b;
+        uint64_t significand_a = normalized_significand(*a, exponent_a);
+        uint64_t significand_b = normalized_significand(*b, exponent_b);
+
+        // the significand ratio lies in (1/2, 2): keep mantissa_bits + 1
+        // quotient bits below the leading one, truncating the rest
+        unsigned __int128 quotient = (static_cast<unsigned __int128>(significand_a) << (mantissa_bits + 1))
+                                   / significand_b;
+        long long exponent = exponent_a - exponent_b + ((1LL << (a->get_exponent_bits() - 1)) - 1);
+        if (quotient >> (mantissa_bits + 1)) quotient >>= 1;
+        else exponent -= 1;
+
+        if (exponent >= max_exponent) {
+            result->set_inf();
+        } else if (exponent <= 0) {
+            // subnormal range: shift the implicit bit out from the minimum exponent
+            long long shift = 1 - exponent;
+            quotient = shift > static_cast<long long>(mantissa_bits) + 1 ? 0 : quotient >> shift;
+            result->exponent = 0;
+            result->mantissa = static_cast<unsigned long long>(quotient);
+            if (quotient == 0) FLEXFLOAT_COUNT(OpKind::divide, result->get_format(), Event::flush_to_zero);
+        } else {
+            result->exponent = static_cast<unsigned long long>(exponent);
+            result->mantissa = static_cast<unsigned long long>(quotient) & ((1ULL << mantissa_bits) - 1);
+        }
+    }
+
     result->IEEE754_status_update();
+    // x / 0 is an exact inf, not an overflow
+    if (b->status != Status::zero) count_result_events(OpKind::divide, *a, *b, *result);
     result->clamp_to_format();
     return true;
 }
 
-bool Adder::add(ExMy* a, ExMy* b, ExMy* result) {
-    if (!data_format_cmp(*a, *b)) return false;
-
-    // make safe copies of a and b
-    CustomFP::ExMy a_copy = *a;
-    CustomFP::ExMy b_copy = *b;
+// a + b with a's mantissa width; shared by Adder and Subtractor
+static void add_signed(const ExMy& a, const ExMy& b, ExMy* result, OpKind op) {
+    // work on copies; the operands are never modified
+    CustomFP::ExMy a_copy = a;
+    CustomFP::ExMy b_copy = b;
 
     unsigned mantissa_bits = a_copy.get_mantissa_bits();
     unsigned implicit_bit = (1ULL << mantissa_bits);
@@ -158,19 +444,28 @@ bool Adder::add(ExMy* a, ExMy* b, ExMy* result) {
     if (b_copy.get_flag() == CustomFP::ExMy::FP_status::normal)
         b_copy.mantissa |= implicit_bit;
 
-    if(a_copy.get_flag() == CustomFP::ExMy::FP_status::inf 
-        || b_copy.get_flag() == CustomFP::ExMy::FP_status::inf){
-            result->set_inf();
-            return true;
+    // special operands: the result never depends on what result held before
+    using Status = CustomFP::ExMy::FP_status;
+    if (a.status == Status::NaN || b.status == Status::NaN
+        || (a.status == Status::inf && b.status == Status::inf && a.sign != b.sign)) {
+        result->sign = a.status == Status::NaN ? a.sign : b.status == Status::NaN ? b.sign : 0;
+        set_quiet_nan(result);
+        count_result_events(op, a, b, *result);
+        return;
+    }
+    if (a.status == Status::inf || b.status == Status::inf) {
+        result->sign = a.status == Status::inf ? a.sign : b.sign;
+        result->set_inf();
+        return;
     }
 
-    if(check_alignment(a_copy, b_copy)){
+    if(Operator().check_alignment(a_copy, b_copy)){
         // align mantissas by shifting the one with smaller exponent
         if (a_copy.exponent > b_copy.exponent) {
-            align(&b_copy, &a_copy);
+            align_mantissa(&b_copy, &a_copy);
             result->exponent = a_copy.exponent;
         } else {
-            align(&a_copy, &b_copy);
+            align_mantissa(&a_copy, &b_copy);
             result->exponent = b_copy.exponent;
         }
     } else {
@@ -196,41 +491,50 @@ bool Adder::add(ExMy* a, ExMy* b, ExMy* result) {
             result->mantissa = b_copy.mantissa - a_copy.mantissa;
             result->sign = b_copy.sign;
         }
+        count_cancellation(op, *result, std::max(a_copy.mantissa, b_copy.mantissa), result->mantissa);
     }
 
     result->IEEE754_status_update();  // set normal/subnormal/zero status
+    count_result_events(op, a, b, *result);
     result->clamp_to_format();        // trim bits and remove implicit 1 if needed
+}
+
+bool Adder::add(const ExMy* a, const ExMy* b, ExMy* result) const {
+    if (!data_format_cmp(*a, *b)) return false;
+    FLEXFLOAT_TRACE_SCOPE(OpKind::add, *a, *b, *result);
+    add_signed(*a, *b, result, OpKind::add);
     return true;
 }
 
 // Subtractor
-bool Subtractor::subtract(ExMy* a, ExMy* b, ExMy* result) {
+bool Subtractor::subtract(const ExMy* a, const ExMy* b, ExMy* result) const {
     if (!data_format_cmp(*a, *b)) return false;
-    align(a, result);
-    align(b, result);
-    result->exponent = a->exponent;
-
+    FLEXFLOAT_TRACE_SCOPE(OpKind::subtract, *a, *b, *result);
     ExMy b_neg = *b;
     b_neg.sign = !b->sign;
+    add_signed(*a, b_neg, result, OpKind::subtract);
+    return true;
+}
 
-    if (a->sign == b_neg.sign) {
-        result->mantissa = a->mantissa + b_neg.mantissa;
-        result->sign = a->sign;
-    } else {
-        if (a->mantissa > b_neg.mantissa) {
-            result->mantissa = a->mantissa - b_neg.mantissa;
-            result->sign = a->sign;
-        } else {
-            result->mantissa = b_neg.mantissa - a->mantissa;
-            result->sign = b_neg.sign;
-        }
-    }
+// Value-returning operators
+static ExMy nan_like(const ExMy& a) {
+    ExMy result(a.get_sign_bits(), a.get_exponent_bits(), a.get_mantissa_bits());
+    set_quiet_nan(&result);
+    return result;
+}
 
-    result->IEEE754_status_update();
-    result->clamp_to_format();
-    return true;
+template <typename Op, typename Method>
+static ExMy apply(const Op& op, Method method, const ExMy& a, const ExMy& b) {
+    ExMy result(a.get_sign_bits(), a.get_exponent_bits(), a.get_mantissa_bits());
+    if (!(op.*method)(&a, &b, &result)) return nan_like(a);
+    return result;
 }
 
+ExMy add(const ExMy& a, const ExMy& b) { return apply(Adder(), &Adder::add, a, b); }
+ExMy subtract(const ExMy& a, const ExMy& b) { return apply(Subtractor(), &Subtractor::subtract, a, b); }
+ExMy multiply(const ExMy& a, const ExMy& b) { return apply(Multiplier(), &Multiplier::mul, a, b); }
+ExMy divide(const ExMy& a, const ExMy& b) { return apply(Divider(), &Divider::divide, a, b); }
+
 void print_raw_fp(const ExMy& f, const char* label) {
     std::cout << label << ": "
               << f.sign << " "
@@ -0,0 +1,78 @@
+#include "Executor.hpp"
+#include <algorithm>
+
+namespace CustomFP {
+
+AutoGrain::AutoGrain(size_t initial, size_t min_grain, size_t max_grain)
+    : min_grain(std::max<size_t>(1, min_grain)), max_grain(std::max(max_grain, std::max<size_t>(1, min_grain))),
+      best_rate(0.0), growing(true), reversed(false), settled(false) {
+    best_grain = std::min(std::max(initial, this->min_grain), this->max_grain);
+    trial_grain = best_grain;
+}
+
+// pick the next trial from best_grain, turning around or settling at the bounds
+void AutoGrain::advance() {
+    while (true) {
+        if (growing && best_grain <= max_grain / 2) {
+            trial_grain = best_grain * 2;
+            return;
+        }
+        if (!growing && best_grain / 2 >= min_grain) {
+            trial_grain = best_grain / 2;
+            return;
+        }
+        if (reversed) {
+            settled = true;
+            trial_grain = best_grain;
+            return;
+        }
+        reversed = true;
+        growing = !growing;
+    }
+}
+
+size_t AutoGrain::next_grain() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return settled ? best_grain : trial_grain;
+}
+
+void AutoGrain::record(size_t grain, size_t elements, double seconds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    // stale reports from concurrent calls at another grain are dropped
+    if (settled || grain != trial_grain || elements == 0 || seconds <= 0.0) return;
+    double rate = static_cast<double>(elements) / seconds;
+
+    if (best_rate == 0.0 || rate > best_rate * 1.05) {
+        best_rate = rate;
+        best_grain = grain;
+    } else if (!reversed) {
+        reversed = true;
+        growing = !growing;
+    } else {
+        settled = true;
+        trial_grain = best_grain;
+        return;
+    }
+    advance();
+}
+
+size_t AutoGrain::get_grain() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return best_grain;
+}
+
+bool AutoGrain::is_settled() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return settled;
+}
+
+void parallel_for(ThreadPool& pool, size_t begin, size_t end, AutoGrain& tuner,
+                  const std::function<void(size_t, size_t)>& body) {
+    size_t grain = tuner.next_grain();
+    auto start = std::chrono::steady_clock::now();
+    pool.parallel_for(begin, end, grain, body);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    if (end > begin) tuner.record(grain, end - begin, elapsed.count());
+}
+
+}
@@ -0,0 +1,268 @@
+#include "Expression.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+namespace CustomFP {
+
+// elements processed per instruction before moving to the next one
+static constexpr size_t block_size = 256;
+
+Expr::Expr(const Tensor& tensor) {
+    auto leaf = std::make_shared<Node>();
+    leaf->op = Op::tensor;
+    leaf->tensor = &tensor;
+    node = std::move(leaf);
+}
+
+Expr::Expr(double value) {
+    auto leaf = std::make_shared<Node>();
+    leaf->op = Op::constant;
+    leaf->tensor = nullptr;
+    leaf->value = value;
+    node = std::move(leaf);
+}
+
+Expr::Expr(Op op, const Expr& lhs, const Expr& rhs) {
+    auto inner = std::make_shared<Node>();
+    inner->op = op;
+    inner->tensor = nullptr;
+    inner->lhs = lhs.node;
+    inner->rhs = rhs.node;
+    node = std::move(inner);
+}
+
+Expr operator+(const Expr& a, const Expr& b) { return Expr(Expr::Op::add, a, b); }
+Expr operator-(const Expr& a, const Expr& b) { return Expr(Expr::Op::sub, a, b); }
+Expr operator*(const Expr& a, const Expr& b) { return Expr(Expr::Op::mul, a, b); }
+Expr operator/(const Expr& a, const Expr& b) { return Expr(Expr::Op::div, a, b); }
+Expr operator-(const Expr& a) { return Expr(Expr::Op::neg, a, a); }
+Expr abs(const Expr& a) { return Expr(Expr::Op::abs, a, a); }
+Expr relu(const Expr& a) { return Expr(Expr::Op::relu, a, a); }
+Expr min(const Expr& a, const Expr& b) { return Expr(Expr::Op::min, a, b); }
+Expr max(const Expr& a, const Expr& b) { return Expr(Expr::Op::max, a, b); }
+
+Expr round(const Expr& e, Format format, RoundingMode mode) {
+    auto inner = std::make_shared<Expr::Node>();
+    inner->op = Expr::Op::round;
+    inner->tensor = nullptr;
+    inner->format = format;
+    inner->mode = mode;
+    inner->lhs = e.get_node();
+    return Expr(std::move(inner));
+}
+
+// one step of the compiled program; every node owns one slot of two
+// block-sized lanes, the value and its error term
+struct Instruction {
+    Expr::Op op;
+    size_t dst;
+    size_t lhs;
+    size_t rhs;
+    const Tensor* tensor;
+    const double* broadcast;   // decoded leaf smaller than the output
+    size_t broadcast_size;
+    double value;
+    Format format;
+    RoundingMode mode;
+};
+
+struct Program {
+    std::vector<Instruction> code;
+    std::vector<std::vector<double>> broadcasts;
+    std::map<const Expr::Node*, size_t> slots;
+    size_t output_size;
+    bool valid = true;
+};
+
+static size_t compile(const Expr::Node* node, Program& program) {
+    auto found = program.slots.find(node);
+    if (found != program.slots.end()) return found->second;
+
+    Instruction instr{};
+    instr.op = node->op;
+    switch (node->op) {
+        case Expr::Op::tensor: {
+            instr.tensor = node->tensor;
+            size_t size = node->tensor->size();
+            if (size == 0 || program.output_size % size != 0) {
+                program.valid = false;
+            } else if (size != program.output_size) {
+                std::vector<double> decoded(size);
+                node->tensor->decode_range(0, size, decoded.data());
+                program.broadcasts.push_back(std::move(decoded));
+                instr.broadcast = program.broadcasts.back().data();
+                instr.broadcast_size = size;
+            }
+            break;
+        }
+        case Expr::Op::constant:
+            instr.value = node->value;
+            break;
+        case Expr::Op::round:
+            instr.format = node->format;
+            instr.mode = node->mode;
+            instr.lhs = compile(node->lhs.get(), program);
+            break;
+        default:
+            instr.lhs = compile(node->lhs.get(), program);
+            instr.rhs = compile(node->rhs.get(), program);
+            break;
+    }
+    instr.dst = program.slots.size();
+    program.slots[node] = instr.dst;
+    program.code.push_back(instr);
+    return instr.dst;
+}
+
+// value + error term pairs: the value is the double nearest the pair and
+// |error| is at most half an ulp of it
+static void renormalize(double sum, double error, double& hi, double& lo) {
+    hi = sum + error;
+    lo = std::isfinite(hi) ? error - (hi - sum) : 0.0;
+}
+
+static void pair_add(double ah, double al, double bh, double bl, double& hi, double& lo) {
+    double sum = ah + bh;
+    if (!std::isfinite(sum)) {
+        hi = sum;
+        lo = 0.0;
+        return;
+    }
+    double b_part = sum - ah;
+    double error = (ah - (sum - b_part)) + (bh - b_part);
+    renormalize(sum, error + al + bl, hi, lo);
+}
+
+static void pair_mul(double ah, double al, double bh, double bl, double& hi, double& lo) {
+    double product = ah * bh;
+    if (!std::isfinite(product)) {
+        hi = product;
+        lo = 0.0;
+        return;
+    }
+    renormalize(product, std::fma(ah, bh, -product) + ah * bl + al * bh, hi, lo);
+}
+
+static void pair_div(double ah, double al, double bh, double bl, double& hi, double& lo) {
+    double quotient = ah / bh;
+    if (!std::isfinite(quotient) || !std::isfinite(bh)) {
+        hi = quotient;
+        lo = 0.0;
+        return;
+    }
+    // the remainder of the leading parts is exact
+    double remainder = std::fma(-quotient, bh, ah) + al - quotient * bl;
+    renormalize(quotient, remainder / bh, hi, lo);
+}
+
+// pair ordering for min / max; a NaN loses to any number
+static bool pair_less(double ah, double al, double bh, double bl) {
+    return ah < bh || (ah == bh && al < bl);
+}
+
+static void run_block(const Program& program, size_t start, size_t count, double* scratch) {
+    for (const Instruction& instr : program.code) {
+        double* dst = scratch + instr.dst * 2 * block_size;
+        double* dst_lo = dst + block_size;
+        const double* a = scratch + instr.lhs * 2 * block_size;
+        const double* a_lo = a + block_size;
+        const double* b = scratch + instr.rhs * 2 * block_size;
+        const double* b_lo = b + block_size;
+        switch (instr.op) {
+            case Expr::Op::tensor:
+                if (instr.broadcast) {
+                    size_t offset = start % instr.broadcast_size;
+                    for (size_t i = 0; i < count; ++i) {
+                        dst[i] = instr.broadcast[offset];
+                        if (++offset == instr.broadcast_size) offset = 0;
+                    }
+                } else {
+                    instr.tensor->decode_range(start, start + count, dst);
+                }
+                std::fill(dst_lo, dst_lo + count, 0.0);
+                break;
+            case Expr::Op::constant:
+                std::fill(dst, dst + count, instr.value);
+                std::fill(dst_lo, dst_lo + count, 0.0);
+                break;
+            case Expr::Op::neg:
+                for (size_t i = 0; i < count; ++i) {
+                    dst[i] = -a[i];
+                    dst_lo[i] = -a_lo[i];
+                }
+                break;
+            case Expr::Op::abs:
+                for (size_t i = 0; i < count; ++i) {
+                    bool negative = std::signbit(a[i]);
+                    dst[i] = negative ? -a[i] : a[i];
+                    dst_lo[i] = negative ? -a_lo[i] : a_lo[i];
+                }
+                break;
+            case Expr::Op::relu:
+                for (size_t i = 0; i < count; ++i) {
+                    bool keep = a[i] > 0.0 || std::isnan(a[i]);
+                    dst[i] = keep ? a[i] : 0.0;
+                    dst_lo[i] = keep ? a_lo[i] : 0.0;
+                }
+                break;
+            case Expr::Op::add:
+                for (size_t i = 0; i < count; ++i) pair_add(a[i], a_lo[i], b[i], b_lo[i], dst[i], dst_lo[i]);
+                break;
+            case Expr::Op::sub:
+                for (size_t i = 0; i < count; ++i) pair_add(a[i], a_lo[i], -b[i], -b_lo[i], dst[i], dst_lo[i]);
+                break;
+            case Expr::Op::mul:
+                for (size_t i = 0; i < count; ++i) pair_mul(a[i], a_lo[i], b[i], b_lo[i], dst[i], dst_lo[i]);
+                break;
+            case Expr::Op::div:
+                for (size_t i = 0; i < count; ++i) pair_div(a[i], a_lo[i], b[i], b_lo[i], dst[i], dst_lo[i]);
+                break;
+            case Expr::Op::min:
+            case Expr::Op::max:
+                for (size_t i = 0; i < count; ++i) {
+                    bool pick_b;
+                    if (std::isnan(a[i])) pick_b = true;
+                    else if (std::isnan(b[i])) pick_b = false;
+                    else if (instr.op == Expr::Op::min) pick_b = pair_less(b[i], b_lo[i], a[i], a_lo[i]);
+                    else pick_b = pair_less(a[i], a_lo[i], b[i], b_lo[i]);
+                    dst[i] = pick_b ? b[i] : a[i];
+                    dst_lo[i] = pick_b ? b_lo[i] : a_lo[i];
+                }
+                break;
+            case Expr::Op::round:
+                for (size_t i = 0; i < count; ++i) {
+                    dst[i] = round_sum(a[i], a_lo[i], instr.format, instr.mode);
+                    dst_lo[i] = 0.0;
+                }
+                break;
+        }
+    }
+}
+
+bool Expr::eval(Tensor& out, RoundingMode mode) const {
+    Program program;
+    program.output_size = out.size();
+    size_t root = compile(node.get(), program);
+    if (!program.valid) return false;
+
+    size_t slots = program.slots.size();
+    size_t blocks = (program.output_size + block_size - 1) / block_size;
+    parallel_for(0, blocks, 16, [&](size_t first, size_t last) {
+        std::vector<double> scratch(slots * 2 * block_size);
+        Format format = out.get_format();
+        for (size_t block = first; block < last; ++block) {
+            size_t start = block * block_size;
+            size_t count = std::min(block_size, program.output_size - start);
+            run_block(program, start, count, scratch.data());
+            // the only rounding of the pair unless a round() node came first
+            double* result = scratch.data() + root * 2 * block_size;
+            for (size_t i = 0; i < count; ++i) result[i] = round_sum(result[i], result[i + block_size], format, mode);
+            out.encode_range(start, start + count, result, mode);
+        }
+    });
+    return true;
+}
+
+}
@@ -0,0 +1,147 @@
+#include "FFT.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace CustomFP {
+
+// butterflies per parallel_for chunk inside one transform
+static constexpr size_t butterfly_grain = 1 << 12;
+
+FFTPlan::FFTPlan(size_t n, Format format, bool inverse, FFTRadix radix,
+                 ComplexMul algorithm, RoundingMode mode)
+    : n(n), log2n(0), format(format), inverse(inverse), radix(radix),
+      algorithm(algorithm), mode(mode) {
+    if (!is_valid()) return;
+    while ((size_t(1) << log2n) < n) ++log2n;
+
+    const double pi = std::acos(-1.0);
+    double sign = inverse ? 1.0 : -1.0;
+    twiddle_re.resize(n);
+    twiddle_im.resize(n);
+    for (size_t k = 0; k < n; ++k) {
+        double angle = sign * 2.0 * pi * static_cast<double>(k) / static_cast<double>(n);
+        twiddle_re[k] = round_value(std::cos(angle), format, mode);
+        twiddle_im[k] = round_value(std::sin(angle), format, mode);
+    }
+
+    bit_reverse.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        size_t reversed = 0;
+        for (unsigned b = 0; b < log2n; ++b)
+            if (i & (size_t(1) << b)) reversed |= size_t(1) << (log2n - 1 - b);
+        bit_reverse[i] = reversed;
+    }
+}
+
+// combine blocks of size half into blocks of size 2 * half
+void FFTPlan::radix2_stage(double* re, double* im, size_t half) const {
+    size_t stride = n / (2 * half);
+    auto add = [&](double x, double y) { return round_sum(x, y, format, mode); };
+    parallel_for(0, n / 2, butterfly_grain, [&](size_t first, size_t last) {
+        for (size_t b = first; b < last; ++b) {
+            size_t j = b % half;
+            size_t i0 = (b / half) * 2 * half + j;
+            size_t i1 = i0 + half;
+            double tr = re[i1], ti = im[i1];
+            if (j != 0)
+                complex_mul(re[i1], im[i1], twiddle_re[j * stride], twiddle_im[j * stride],
+                            tr, ti, format, algorithm, mode);
+            double xr = re[i0], xi = im[i0];
+            re[i0] = add(xr, tr);
+            im[i0] = add(xi, ti);
+            re[i1] = add(xr, -tr);
+            im[i1] = add(xi, -ti);
+        }
+    });
+}
+
+// combine blocks of size quarter into blocks of size 4 * quarter; equivalent
+// to two radix-2 stages with three twiddle products instead of four
+void FFTPlan::radix4_stage(double* re, double* im, size_t quarter) const {
+    size_t stride = n / (4 * quarter);
+    auto add = [&](double x, double y) { return round_sum(x, y, format, mode); };
+    parallel_for(0, n / 4, butterfly_grain, [&](size_t first, size_t last) {
+        for (size_t b = first; b < last; ++b) {
+            size_t j = b % quarter;
+            size_t i0 = (b / quarter) * 4 * quarter + j;
+            size_t i1 = i0 + quarter, i2 = i1 + quarter, i3 = i2 + quarter;
+
+            double t1r = re[i1], t1i = im[i1];
+            double t2r = re[i2], t2i = im[i2];
+            double t3r = re[i3], t3i = im[i3];
+            if (j != 0) {
+                size_t k = j * stride;
+                complex_mul(re[i1], im[i1], twiddle_re[2 * k], twiddle_im[2 * k], t1r, t1i, format, algorithm, mode);
+                complex_mul(re[i2], im[i2], twiddle_re[k], twiddle_im[k], t2r, t2i, format, algorithm, mode);
+                complex_mul(re[i3], im[i3], twiddle_re[3 * k], twiddle_im[3 * k], t3r, t3i, format, algorithm, mode);
+            }
+
+            double a0r = add(re[i0], t1r), a0i = add(im[i0], t1i);
+            double a1r = add(re[i0], -t1r), a1i = add(im[i0], -t1i);
+            double sr = add(t2r, t3r), si = add(t2i, t3i);
+            double dr = add(t2r, -t3r), di = add(t2i, -t3i);
+            // d * (-i) forward, d * (+i) inverse: exact swap and negate
+            double rot_r = inverse ? -di : di;
+            double rot_i = inverse ? dr : -dr;
+
+            re[i0] = add(a0r, sr);
+            im[i0] = add(a0i, si);
+            re[i2] = add(a0r, -sr);
+            im[i2] = add(a0i, -si);
+            re[i1] = add(a1r, rot_r);
+            im[i1] = add(a1i, rot_i);
+            re[i3] = add(a1r, -rot_r);
+            im[i3] = add(a1i, -rot_i);
+        }
+    });
+}
+
+void FFTPlan::transform(double* re, double* im) const {
+    for (size_t i = 0; i < n; ++i) {
+        size_t j = bit_reverse[i];
+        if (i < j) {
+            std::swap(re[i], re[j]);
+            std::swap(im[i], im[j]);
+        }
+    }
+
+    size_t size = 1;
+    if (radix == FFTRadix::radix4) {
+        if (log2n % 2) {
+            radix2_stage(re, im, 1);
+            size = 2;
+        }
+        for (; size < n; size *= 4) radix4_stage(re, im, size);
+    } else {
+        for (; size < n; size *= 2) radix2_stage(re, im, size);
+    }
+}
+
+void FFTPlan::execute(double* re, double* im) const {
+    if (is_valid()) transform(re, im);
+}
+
+bool FFTPlan::execute(Tensor& re, Tensor& im, size_t batch) const {
+    if (!is_valid() || re.size() != n * batch || im.size() != n * batch) return false;
+    parallel_for(0, batch, 1, [&](size_t first, size_t last) {
+        std::vector<double> xr(n), xi(n);
+        for (size_t b = first; b < last; ++b) {
+            re.decode_range(b * n, (b + 1) * n, xr.data());
+            im.decode_range(b * n, (b + 1) * n, xi.data());
+            // inputs in another format are rounded into the plan's format first
+            if (re.get_format() != format || im.get_format() != format) {
+                for (size_t i = 0; i < n; ++i) {
+                    xr[i] = round_value(xr[i], format, mode);
+                    xi[i] = round_value(xi[i], format, mode);
+                }
+            }
+            transform(xr.data(), xi.data());
+            re.encode_range(b * n, (b + 1) * n, xr.data(), mode);
+            im.encode_range(b * n, (b + 1) * n, xi.data(), mode);
+        }
+    });
+    return true;
+}
+
+}
@@ -0,0 +1,186 @@
+#include "Instrumentation.hpp"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+
+namespace CustomFP {
+
+// distinct result formats tracked per thread; further formats share the
+// extra slot at index max_formats, reported as Format{0, 0}
+static constexpr size_t max_formats = 32;
+static constexpr size_t op_count = static_cast<size_t>(OpKind::count);
+static constexpr size_t event_count = static_cast<size_t>(Event::count);
+
+const char* op_kind_name(OpKind op) {
+    switch (op) {
+        case OpKind::add: return "add";
+        case OpKind::subtract: return "subtract";
+        case OpKind::multiply: return "multiply";
+        case OpKind::divide: return "divide";
+        case OpKind::align: return "align";
+        case OpKind::convert: return "convert";
+        default: return "unknown";
+    }
+}
+
+const char* event_name(Event event) {
+    switch (event) {
+        case Event::alignment_loss: return "alignment_loss";
+        case Event::cancellation: return "cancellation";
+        case Event::overflow: return "overflow";
+        case Event::flush_to_zero: return "flush_to_zero";
+        case Event::subnormal: return "subnormal";
+        case Event::nan_propagation: return "nan_propagation";
+        default: return "unknown";
+    }
+}
+
+// Per-thread buffer. Only the owning thread writes; the relaxed atomics
+// compile to plain loads and stores and only make the concurrent snapshot
+// reads well defined.
+struct ThreadCounters {
+    std::atomic<unsigned> keys[max_formats];
+    std::atomic<size_t> used{0};
+    std::atomic<unsigned long long> counts[max_formats + 1][op_count][event_count];
+    size_t last_slot = 0;
+
+    ThreadCounters() {
+        for (auto& key : keys) key.store(0, std::memory_order_relaxed);
+        clear();
+    }
+
+    void clear() {
+        for (auto& slot : counts)
+            for (auto& op : slot)
+                for (auto& c : op) c.store(0, std::memory_order_relaxed);
+    }
+
+    size_t slot_of(unsigned key) {
+        if (keys[last_slot].load(std::memory_order_relaxed) == key) return last_slot;
+        size_t n = used.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < n; ++i) {
+            if (keys[i].load(std::memory_order_relaxed) == key) return last_slot = i;
+        }
+        if (n == max_formats) return max_formats;
+        keys[n].store(key, std::memory_order_relaxed);
+        used.store(n + 1, std::memory_order_release);
+        return last_slot = n;
+    }
+};
+
+// buffers outlive their threads so exited threads still count; a buffer
+// released by an exiting thread is handed to the next new thread. The
+// registry is never destroyed: pool workers can exit during static
+// destruction and still release their buffers.
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadCounters>> buffers;
+    std::vector<ThreadCounters*> released;
+};
+
+static Registry& registry() {
+    static Registry* instance = new Registry;
+    return *instance;
+}
+
+struct ThreadHandle {
+    ThreadCounters* counters = nullptr;
+
+    ~ThreadHandle() {
+        if (!counters) return;
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.released.push_back(counters);
+    }
+
+    ThreadCounters& get() {
+        if (counters) return *counters;
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        if (!reg.released.empty()) {
+            counters = reg.released.back();
+            reg.released.pop_back();
+        } else {
+            reg.buffers.push_back(std::make_unique<ThreadCounters>());
+            counters = reg.buffers.back().get();
+        }
+        return *counters;
+    }
+};
+
+static unsigned format_key(Format format) {
+    // exponent_bits >= 1, so a real key is never 0
+    return (format.exponent_bits << 8) | format.mantissa_bits;
+}
+
+void count_event(OpKind op, Format format, Event event) {
+    static thread_local ThreadHandle handle;
+    ThreadCounters& counters = handle.get();
+    auto& c = counters.counts[counters.slot_of(format_key(format))]
+                             [static_cast<size_t>(op)][static_cast<size_t>(event)];
+    c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+std::vector<EventCounts> event_snapshot() {
+    std::map<std::pair<size_t, unsigned>, EventCounts> merged;
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (const auto& buffer : reg.buffers) {
+        size_t used = buffer->used.load(std::memory_order_acquire);
+        for (size_t slot = 0; slot <= max_formats; ++slot) {
+            if (slot >= used && slot < max_formats) continue;
+            unsigned key = slot < max_formats ? buffer->keys[slot].load(std::memory_order_relaxed) : 0;
+            for (size_t op = 0; op < op_count; ++op) {
+                for (size_t ev = 0; ev < event_count; ++ev) {
+                    unsigned long long c = buffer->counts[slot][op][ev].load(std::memory_order_relaxed);
+                    if (c == 0) continue;
+                    auto it = merged.find({op, key});
+                    if (it == merged.end()) {
+                        EventCounts entry{};
+                        entry.op = static_cast<OpKind>(op);
+                        entry.format = Format{key >> 8, key & 0xFF};
+                        it = merged.emplace(std::make_pair(op, key), entry).first;
+                    }
+                    it->second.counts[ev] += c;
+                }
+            }
+        }
+    }
+
+    std::vector<EventCounts> result;
+    for (const auto& entry : merged) result.push_back(entry.second);
+    return result;
+}
+
+void reset_event_counters() {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (auto& buffer : reg.buffers) buffer->clear();
+}
+
+void write_event_json(std::ostream& out) {
+    auto entries = event_snapshot();
+    out << "{\"events\": [";
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const auto& entry = entries[i];
+        out << (i ? ", " : "") << "{\"op\": \"" << op_kind_name(entry.op) << "\", \"format\": \"";
+        if (entry.format.exponent_bits == 0) out << "other";
+        else out << "e" << entry.format.exponent_bits << "m" << entry.format.mantissa_bits;
+        out << "\"";
+        for (size_t ev = 0; ev < event_count; ++ev)
+            out << ", \"" << event_name(static_cast<Event>(ev)) << "\": " << entry.counts[ev];
+        out << "}";
+    }
+    out << "]}";
+}
+
+std::string event_json() {
+    std::ostringstream out;
+    write_event_json(out);
+    return out.str();
+}
+
+}
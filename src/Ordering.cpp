@@ -0,0 +1,416 @@
+#include "Ordering.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <mutex>
+
+namespace CustomFP {
+
+// elements per parallel_for chunk for the streaming kernels
+static constexpr size_t stream_grain = 1 << 16;
+
+// Scalar
+unsigned long long to_order_key(unsigned long long raw, Format fmt) {
+    const unsigned long long sign = 1ULL << (fmt.exponent_bits + fmt.mantissa_bits);
+    const unsigned long long mask = sign | (sign - 1);
+    return (raw & sign) ? (~raw & mask) : (raw | sign);
+}
+
+unsigned long long from_order_key(unsigned long long key, Format fmt) {
+    const unsigned long long sign = 1ULL << (fmt.exponent_bits + fmt.mantissa_bits);
+    const unsigned long long mask = sign | (sign - 1);
+    return (key & sign) ? (key ^ sign) : (~key & mask);
+}
+
+bool is_nan_bits(unsigned long long raw, Format fmt) {
+    const unsigned long long sign = 1ULL << (fmt.exponent_bits + fmt.mantissa_bits);
+    const unsigned long long inf = ((1ULL << fmt.exponent_bits) - 1) << fmt.mantissa_bits;
+    return (raw & (sign - 1)) > inf;
+}
+
+static bool is_zero_bits(unsigned long long raw, Format fmt) {
+    const unsigned long long sign = 1ULL << (fmt.exponent_bits + fmt.mantissa_bits);
+    return (raw & (sign - 1)) == 0;
+}
+
+bool total_order(unsigned long long a, unsigned long long b, Format fmt) {
+    return to_order_key(a, fmt) <= to_order_key(b, fmt);
+}
+
+bool fp_less(unsigned long long a, unsigned long long b, Format fmt) {
+    if (is_nan_bits(a, fmt) || is_nan_bits(b, fmt)) return false;
+    if (is_zero_bits(a, fmt) && is_zero_bits(b, fmt)) return false;
+    return to_order_key(a, fmt) < to_order_key(b, fmt);
+}
+
+bool fp_equal(unsigned long long a, unsigned long long b, Format fmt) {
+    if (is_nan_bits(a, fmt) || is_nan_bits(b, fmt)) return false;
+    if (is_zero_bits(a, fmt) && is_zero_bits(b, fmt)) return true;
+    return a == b;
+}
+
+unsigned long long fp_min(unsigned long long a, unsigned long long b, Format fmt) {
+    if (is_nan_bits(a, fmt)) return a;
+    if (is_nan_bits(b, fmt)) return b;
+    return to_order_key(a, fmt) <= to_order_key(b, fmt) ? a : b;
+}
+
+unsigned long long fp_max(unsigned long long a, unsigned long long b, Format fmt) {
+    if (is_nan_bits(a, fmt)) return a;
+    if (is_nan_bits(b, fmt)) return b;
+    return to_order_key(a, fmt) >= to_order_key(b, fmt) ? a : b;
+}
+
+unsigned long long fp_abs(unsigned long long raw, Format fmt) {
+    return raw & ((1ULL << (fmt.exponent_bits + fmt.mantissa_bits)) - 1);
+}
+
+unsigned long long fp_neg(unsigned long long raw, Format fmt) {
+    return raw ^ (1ULL << (fmt.exponent_bits + fmt.mantissa_bits));
+}
+
+// ExMy
+static bool same_format(const ExMy& a, const ExMy& b) {
+    return a.get_format() == b.get_format();
+}
+
+bool operator==(const ExMy& a, const ExMy& b) {
+    if (same_format(a, b)) return fp_equal(a.get_raw_bits(), b.get_raw_bits(), a.get_format());
+    return decode(a.get_raw_bits(), a.get_format()) == decode(b.get_raw_bits(), b.get_format());
+}
+
+bool operator!=(const ExMy& a, const ExMy& b) { return !(a == b); }
+
+bool operator<(const ExMy& a, const ExMy& b) {
+    if (same_format(a, b)) return fp_less(a.get_raw_bits(), b.get_raw_bits(), a.get_format());
+    return decode(a.get_raw_bits(), a.get_format()) < decode(b.get_raw_bits(), b.get_format());
+}
+
+bool operator<=(const ExMy& a, const ExMy& b) { return a < b || a == b; }
+bool operator>(const ExMy& a, const ExMy& b) { return b < a; }
+bool operator>=(const ExMy& a, const ExMy& b) { return b < a || a == b; }
+
+// quiet NaN in a's format for operands in different formats
+static ExMy mismatch_nan(const ExMy& a) {
+    Format fmt = a.get_format();
+    ExMy result(a.get_sign_bits(), fmt.exponent_bits, fmt.mantissa_bits);
+    unsigned long long payload = fmt.mantissa_bits ? 1ULL << (fmt.mantissa_bits - 1) : 0;
+    result.set_bits((((1ULL << fmt.exponent_bits) - 1) << fmt.mantissa_bits) | payload);
+    return result;
+}
+
+ExMy min(const ExMy& a, const ExMy& b) {
+    if (!Operator().data_format_cmp(a, b)) return mismatch_nan(a);
+    ExMy result = a;
+    result.set_bits(fp_min(a.get_raw_bits(), b.get_raw_bits(), a.get_format()));
+    return result;
+}
+
+ExMy max(const ExMy& a, const ExMy& b) {
+    if (!Operator().data_format_cmp(a, b)) return mismatch_nan(a);
+    ExMy result = a;
+    result.set_bits(fp_max(a.get_raw_bits(), b.get_raw_bits(), a.get_format()));
+    return result;
+}
+
+ExMy abs(const ExMy& a) {
+    ExMy result = a;
+    result.sign = 0;
+    return result;
+}
+
+ExMy neg(const ExMy& a) {
+    ExMy result = a;
+    result.sign = a.sign ? 0 : 1;
+    return result;
+}
+
+// Batch
+// constants for the branch-free transforms on a packed element type
+template <typename T>
+struct Layout {
+    T sign;
+    T mask;
+    T inf;
+    unsigned top;
+
+    explicit Layout(Format fmt)
+        : sign(static_cast<T>(1ULL << (fmt.exponent_bits + fmt.mantissa_bits))),
+          mask(static_cast<T>(sign | (sign - 1))),
+          inf(static_cast<T>(((1ULL << fmt.exponent_bits) - 1) << fmt.mantissa_bits)),
+          top(fmt.exponent_bits + fmt.mantissa_bits) {}
+
+    T key(T x) const {
+        T flip = static_cast<T>(0 - ((x >> top) & 1));
+        return static_cast<T>((x ^ (flip | sign)) & mask);
+    }
+    T raw(T k) const {
+        T flip = static_cast<T>(static_cast<T>((k >> top) & 1) - 1);
+        return static_cast<T>((k ^ (flip | sign)) & mask);
+    }
+    bool nan(T x) const { return static_cast<T>(x & (sign - 1)) > inf; }
+};
+
+static bool same_shape(const Tensor& a, const Tensor& b) {
+    return a.size() == b.size() && a.get_format() == b.get_format();
+}
+
+template <typename Key>
+static bool order_keys(const Tensor& in, std::vector<Key>& keys) {
+    if (sizeof(Key) < in.get_element_bytes()) return false;
+    keys.resize(in.size());
+    visit_element_type(in, [&](auto tag) {
+        using T = decltype(tag);
+        Layout<T> layout(in.get_format());
+        const T* src = in.data<T>();
+        parallel_for(0, in.size(), stream_grain, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) keys[i] = static_cast<Key>(layout.key(src[i]));
+        });
+    });
+    return true;
+}
+
+bool batch_order_keys(const Tensor& in, std::vector<uint8_t>& keys) { return order_keys(in, keys); }
+bool batch_order_keys(const Tensor& in, std::vector<uint16_t>& keys) { return order_keys(in, keys); }
+bool batch_order_keys(const Tensor& in, std::vector<uint32_t>& keys) { return order_keys(in, keys); }
+bool batch_order_keys(const Tensor& in, std::vector<unsigned long long>& keys) { return order_keys(in, keys); }
+
+bool batch_less(const Tensor& a, const Tensor& b, std::vector<uint8_t>& out) {
+    if (!same_shape(a, b)) return false;
+    out.resize(a.size());
+    visit_element_type(a, [&](auto tag) {
+        using T = decltype(tag);
+        Layout<T> layout(a.get_format());
+        const T* x = a.data<T>();
+        const T* y = b.data<T>();
+        const T magnitude = static_cast<T>(layout.sign - 1);
+        parallel_for(0, a.size(), stream_grain, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                bool ordered = !layout.nan(x[i]) & !layout.nan(y[i]);
+                bool both_zero = static_cast<T>((x[i] | y[i]) & magnitude) == 0;
+                out[i] = ordered & !both_zero & (layout.key(x[i]) < layout.key(y[i]));
+            }
+        });
+    });
+    return true;
+}
+
+template <bool take_max>
+static bool batch_select(const Tensor& a, const Tensor& b, Tensor& out) {
+    if (!same_shape(a, b) || !same_shape(a, out)) return false;
+    visit_element_type(a, [&](auto tag) {
+        using T = decltype(tag);
+        Layout<T> layout(a.get_format());
+        const T* x = a.data<T>();
+        const T* y = b.data<T>();
+        T* z = out.data<T>();
+        parallel_for(0, a.size(), stream_grain, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                T kx = layout.key(x[i]);
+                T ky = layout.key(y[i]);
+                T pick = (take_max ? kx >= ky : kx <= ky) ? x[i] : y[i];
+                pick = layout.nan(y[i]) ? y[i] : pick;
+                z[i] = layout.nan(x[i]) ? x[i] : pick;
+            }
+        });
+    });
+    return true;
+}
+
+bool batch_min(const Tensor& a, const Tensor& b, Tensor& out) { return batch_select<false>(a, b, out); }
+bool batch_max(const Tensor& a, const Tensor& b, Tensor& out) { return batch_select<true>(a, b, out); }
+
+template <bool negate>
+static bool batch_sign(const Tensor& in, Tensor& out) {
+    if (!same_shape(in, out)) return false;
+    visit_element_type(in, [&](auto tag) {
+        using T = decltype(tag);
+        Layout<T> layout(in.get_format());
+        const T* x = in.data<T>();
+        T* z = out.data<T>();
+        parallel_for(0, in.size(), stream_grain, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                z[i] = negate ? static_cast<T>(x[i] ^ layout.sign) : static_cast<T>(x[i] & (layout.sign - 1));
+        });
+    });
+    return true;
+}
+
+bool batch_abs(const Tensor& in, Tensor& out) { return batch_sign<false>(in, out); }
+bool batch_neg(const Tensor& in, Tensor& out) { return batch_sign<true>(in, out); }
+
+// Radix sort
+template <typename T>
+static void radix_sort_typed(T* data, size_t n, Format fmt) {
+    Layout<T> layout(fmt);
+    parallel_for(0, n, stream_grain, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) data[i] = layout.key(data[i]);
+    });
+
+    // fixed partition so every pass sees the same chunks
+    size_t chunk_count = std::max<size_t>(1, std::min<size_t>(ThreadPool::global().get_num_threads() * 4,
+                                                              n / stream_grain + 1));
+    size_t chunk_size = (n + chunk_count - 1) / chunk_count;
+    std::vector<size_t> offsets(chunk_count * 256);
+    std::vector<T> buffer(n);
+    T* src = data;
+    T* dst = buffer.data();
+
+    for (unsigned shift = 0; shift < fmt.get_total_bits(); shift += 8) {
+        std::fill(offsets.begin(), offsets.end(), 0);
+        parallel_for(0, chunk_count, 1, [&](size_t first, size_t last) {
+            for (size_t c = first; c < last; ++c) {
+                size_t* hist = offsets.data() + c * 256;
+                for (size_t i = c * chunk_size; i < std::min(n, (c + 1) * chunk_size); ++i)
+                    hist[(src[i] >> shift) & 0xFF]++;
+            }
+        });
+
+        // a digit shared by every element leaves the order unchanged
+        bool trivial = false;
+        for (size_t d = 0; d < 256 && !trivial; ++d) {
+            size_t total = 0;
+            for (size_t c = 0; c < chunk_count; ++c) total += offsets[c * 256 + d];
+            trivial = total == n;
+        }
+        if (trivial) continue;
+
+        size_t running = 0;
+        for (size_t d = 0; d < 256; ++d) {
+            for (size_t c = 0; c < chunk_count; ++c) {
+                size_t count = offsets[c * 256 + d];
+                offsets[c * 256 + d] = running;
+                running += count;
+            }
+        }
+
+        parallel_for(0, chunk_count, 1, [&](size_t first, size_t last) {
+            for (size_t c = first; c < last; ++c) {
+                size_t* next = offsets.data() + c * 256;
+                for (size_t i = c * chunk_size; i < std::min(n, (c + 1) * chunk_size); ++i)
+                    dst[next[(src[i] >> shift) & 0xFF]++] = src[i];
+            }
+        });
+        std::swap(src, dst);
+    }
+
+    if (src != data) std::memcpy(data, src, n * sizeof(T));
+    parallel_for(0, n, stream_grain, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) data[i] = layout.raw(data[i]);
+    });
+}
+
+void radix_sort(Tensor& t) {
+    visit_element_type(t, [&](auto tag) {
+        using T = decltype(tag);
+        radix_sort_typed(t.data<T>(), t.size(), t.get_format());
+    });
+}
+
+// Selection
+template <typename T>
+static std::vector<size_t> top_k_typed(const T* data, size_t n, size_t k, bool largest, Format fmt) {
+    struct Candidate {
+        T key;
+        size_t index;
+    };
+    auto better = [largest](const Candidate& a, const Candidate& b) {
+        if (a.key != b.key) return largest ? a.key > b.key : a.key < b.key;
+        return a.index < b.index;
+    };
+    // keep the best k of a buffer, leaving the k-th best at position k - 1
+    auto shrink = [&](std::vector<Candidate>& buf) {
+        if (buf.size() <= k) return;
+        std::nth_element(buf.begin(), buf.begin() + (k - 1), buf.end(), better);
+        buf.resize(k);
+    };
+
+    Layout<T> layout(fmt);
+    std::mutex merge_mutex;
+    std::vector<Candidate> merged;
+    parallel_for(0, n, stream_grain, [&](size_t begin, size_t end) {
+        std::vector<Candidate> local;
+        local.reserve(std::min(end - begin, 2 * k));
+        bool has_threshold = false;
+        for (size_t i = begin; i < end; ++i) {
+            Candidate c{layout.key(data[i]), i};
+            // anything worse than a known k-th best is skipped
+            if (has_threshold && !better(c, local[k - 1])) continue;
+            local.push_back(c);
+            if (local.size() == 2 * k || (!has_threshold && local.size() == k)) {
+                std::nth_element(local.begin(), local.begin() + (k - 1), local.end(), better);
+                local.resize(k);
+                has_threshold = true;
+            }
+        }
+        shrink(local);
+        std::lock_guard<std::mutex> lock(merge_mutex);
+        merged.insert(merged.end(), local.begin(), local.end());
+    });
+
+    shrink(merged);
+    std::sort(merged.begin(), merged.end(), better);
+    std::vector<size_t> indices(merged.size());
+    for (size_t i = 0; i < merged.size(); ++i) indices[i] = merged[i].index;
+    return indices;
+}
+
+std::vector<size_t> top_k(const Tensor& t, size_t k, bool largest) {
+    std::vector<size_t> indices;
+    k = std::min(k, t.size());
+    if (k == 0) return indices;
+    visit_element_type(t, [&](auto tag) {
+        using T = decltype(tag);
+        indices = top_k_typed(t.data<T>(), t.size(), k, largest, t.get_format());
+    });
+    return indices;
+}
+
+// MSD radix select: one histogram pass per key byte, restricted to the
+// elements that share the digits chosen so far
+template <typename T>
+static unsigned long long select_rank_typed(const T* data, size_t n, size_t rank, Format fmt) {
+    Layout<T> layout(fmt);
+    unsigned long long prefix = 0;
+    unsigned long long prefix_mask = 0;
+    for (int shift = static_cast<int>((fmt.get_total_bits() - 1) / 8) * 8; shift >= 0; shift -= 8) {
+        std::array<size_t, 256> hist{};
+        std::mutex merge_mutex;
+        parallel_for(0, n, stream_grain, [&](size_t begin, size_t end) {
+            std::array<size_t, 256> local{};
+            for (size_t i = begin; i < end; ++i) {
+                unsigned long long key = layout.key(data[i]);
+                if ((key & prefix_mask) == prefix) local[(key >> shift) & 0xFF]++;
+            }
+            std::lock_guard<std::mutex> lock(merge_mutex);
+            for (size_t d = 0; d < 256; ++d) hist[d] += local[d];
+        });
+
+        unsigned long long digit = 0;
+        while (rank >= hist[digit]) rank -= hist[digit++];
+        prefix |= digit << shift;
+        prefix_mask |= 0xFFULL << shift;
+    }
+    return from_order_key(prefix, fmt);
+}
+
+unsigned long long select_rank(const Tensor& t, size_t rank) {
+    if (t.size() == 0) return 0;
+    rank = std::min(rank, t.size() - 1);
+    unsigned long long raw = 0;
+    visit_element_type(t, [&](auto tag) {
+        using T = decltype(tag);
+        raw = select_rank_typed(t.data<T>(), t.size(), rank, t.get_format());
+    });
+    return raw;
+}
+
+double quantile(const Tensor& t, double q) {
+    if (t.size() == 0) return 0.0;
+    q = std::min(1.0, std::max(0.0, q));
+    size_t rank = static_cast<size_t>(q * static_cast<double>(t.size() - 1));
+    return decode(select_rank(t, rank), t.get_format());
+}
+
+}
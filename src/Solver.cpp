@@ -0,0 +1,262 @@
+#include "Solver.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+
+namespace CustomFP {
+
+// elements per kernel block; dot products sum each block in order and then
+// the block partials in order, so results do not depend on the thread count
+static constexpr size_t block_size = 4096;
+
+using Vector = std::vector<double>;
+
+static double dot(const Vector& x, const Vector& y, Format format, RoundingMode mode) {
+    size_t blocks = (x.size() + block_size - 1) / block_size;
+    Vector partial(blocks, 0.0);
+    parallel_for(0, blocks, 1, [&](size_t first, size_t last) {
+        for (size_t blk = first; blk < last; ++blk) {
+            size_t end = std::min(x.size(), (blk + 1) * block_size);
+            double acc = 0.0;
+            for (size_t i = blk * block_size; i < end; ++i) acc = round_sum(acc, x[i] * y[i], format, mode);
+            partial[blk] = acc;
+        }
+    });
+    double acc = 0.0;
+    for (double p : partial) acc = round_sum(acc, p, format, mode);
+    return acc;
+}
+
+// y = x + alpha * y when scale_y, else y = y + alpha * x
+static void axpy(double alpha, const Vector& x, Vector& y, bool scale_y, Format format, RoundingMode mode) {
+    parallel_for(0, x.size(), block_size, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i)
+            y[i] = scale_y ? round_sum(x[i], alpha * y[i], format, mode)
+                           : round_sum(y[i], alpha * x[i], format, mode);
+    });
+}
+
+// y = A x with the accumulator in matvec, stored in the update format
+static void matvec(const CsrMatrix& a, const Vector& values, const Vector& x, Vector& y,
+                   const SolverConfig& config) {
+    const auto& row_ptr = a.get_row_ptr();
+    parallel_for(0, a.get_rows(), block_size / 16, [&](size_t first, size_t last) {
+        for (size_t r = first; r < last; ++r) {
+            double acc = 0.0;
+            for (size_t k = row_ptr[r]; k < row_ptr[r + 1]; ++k)
+                acc = round_sum(acc, values[k] * x[a.get_col(k)], config.matvec, config.mode);
+            y[r] = round_value(acc, config.update, config.mode);
+        }
+    });
+}
+
+static Vector decode_all(const Tensor& t) {
+    Vector values(t.size());
+    t.decode_range(0, t.size(), values.data());
+    return values;
+}
+
+static void round_all(Vector& v, Format format, RoundingMode mode) {
+    for (double& value : v) value = round_value(value, format, mode);
+}
+
+bool conjugate_gradient(const CsrMatrix& a, const Tensor& b, Tensor& x, SolverResult& result,
+                        const SolverConfig& config) {
+    size_t n = a.get_rows();
+    if (a.get_cols() != n || b.size() != n || x.size() != n) return false;
+    result = SolverResult();
+    const RoundingMode mode = config.mode;
+
+    Vector values = decode_all(a.get_values());
+    Vector inverse_diagonal;
+    if (config.jacobi) {
+        inverse_diagonal.assign(n, 1.0);
+        const auto& row_ptr = a.get_row_ptr();
+        for (size_t r = 0; r < n; ++r) {
+            for (size_t k = row_ptr[r]; k < row_ptr[r + 1]; ++k) {
+                if (a.get_col(k) == r && values[k] != 0.0)
+                    inverse_diagonal[r] = round_value(1.0 / values[k], config.precond, mode);
+            }
+        }
+    }
+    auto precondition = [&](const Vector& r, Vector& z) {
+        if (!config.jacobi) {
+            z = r;
+            return;
+        }
+        parallel_for(0, n, block_size, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i)
+                z[i] = round_value(round_value(inverse_diagonal[i] * r[i], config.precond, mode),
+                                   config.update, mode);
+        });
+    };
+
+    Vector bv = decode_all(b), xv = decode_all(x);
+    round_all(bv, config.update, mode);
+    round_all(xv, config.update, mode);
+    double b_norm = std::sqrt(dot(bv, bv, config.dot, mode));
+    if (b_norm == 0.0) {
+        std::fill(xv.begin(), xv.end(), 0.0);
+        x.encode_range(0, n, xv.data(), mode);
+        result.converged = true;
+        result.residual_history.push_back(0.0);
+        return true;
+    }
+
+    // the history tracks the recursively updated residual, as CG does
+    Vector r(n), z(n), p(n), q(n);
+    matvec(a, values, xv, q, config);
+    for (size_t i = 0; i < n; ++i) r[i] = round_sum(bv[i], -q[i], config.update, mode);
+    double rr = dot(r, r, config.dot, mode);
+    result.residual_history.push_back(std::sqrt(rr) / b_norm);
+    result.converged = result.residual_history.back() <= config.tolerance;
+
+    precondition(r, z);
+    p = z;
+    double rz = dot(r, z, config.dot, mode);
+    while (!result.converged && result.iterations < config.max_iterations) {
+        matvec(a, values, p, q, config);
+        double pq = dot(p, q, config.dot, mode);
+        if (!(pq > 0.0) || !std::isfinite(pq)) break;   // breakdown
+        double alpha = round_value(rz / pq, config.dot, mode);
+        axpy(alpha, p, xv, false, config.update, mode);
+        axpy(-alpha, q, r, false, config.update, mode);
+        ++result.iterations;
+
+        rr = dot(r, r, config.dot, mode);
+        result.residual_history.push_back(std::sqrt(rr) / b_norm);
+        if (!std::isfinite(rr)) break;
+        if (result.residual_history.back() <= config.tolerance) {
+            result.converged = true;
+            break;
+        }
+
+        precondition(r, z);
+        double rz_next = dot(r, z, config.dot, mode);
+        double beta = round_value(rz_next / rz, config.dot, mode);
+        axpy(beta, z, p, true, config.update, mode);
+        rz = rz_next;
+    }
+
+    x.encode_range(0, n, xv.data(), mode);
+    return true;
+}
+
+// LU factors of a row-major n x n matrix with row permutation
+struct LUFactors {
+    size_t n;
+    Vector lu;
+    std::vector<size_t> perm;
+};
+
+static bool lu_factor(LUFactors& f, Format format, RoundingMode mode) {
+    size_t n = f.n;
+    f.perm.resize(n);
+    for (size_t i = 0; i < n; ++i) f.perm[i] = i;
+    for (size_t k = 0; k < n; ++k) {
+        size_t pivot = k;
+        for (size_t i = k + 1; i < n; ++i)
+            if (std::abs(f.lu[i * n + k]) > std::abs(f.lu[pivot * n + k])) pivot = i;
+        if (f.lu[pivot * n + k] == 0.0) return false;
+        if (pivot != k) {
+            std::swap_ranges(f.lu.begin() + k * n, f.lu.begin() + (k + 1) * n, f.lu.begin() + pivot * n);
+            std::swap(f.perm[k], f.perm[pivot]);
+        }
+
+        const double* pivot_row = f.lu.data() + k * n;
+        size_t grain = std::max<size_t>(1, block_size / (n - k));
+        parallel_for(k + 1, n, grain, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                double* row = f.lu.data() + i * n;
+                double l = round_value(row[k] / pivot_row[k], format, mode);
+                row[k] = l;
+                if (l == 0.0) continue;
+                for (size_t j = k + 1; j < n; ++j)
+                    row[j] = round_sum(row[j], -l * pivot_row[j], format, mode);
+            }
+        });
+    }
+    return true;
+}
+
+// solve LU x = P rhs in the factor format
+static Vector lu_solve(const LUFactors& f, const Vector& rhs, Format format, RoundingMode mode) {
+    size_t n = f.n;
+    Vector y(n);
+    for (size_t i = 0; i < n; ++i) {
+        double acc = round_value(rhs[f.perm[i]], format, mode);
+        for (size_t j = 0; j < i; ++j) acc = round_sum(acc, -f.lu[i * n + j] * y[j], format, mode);
+        y[i] = acc;
+    }
+    for (size_t i = n; i-- > 0;) {
+        double acc = y[i];
+        for (size_t j = i + 1; j < n; ++j) acc = round_sum(acc, -f.lu[i * n + j] * y[j], format, mode);
+        y[i] = round_value(acc / f.lu[i * n + i], format, mode);
+    }
+    return y;
+}
+
+bool iterative_refinement(const Tensor& a, const Tensor& b, Tensor& x, SolverResult& result,
+                          const SolverConfig& config) {
+    const auto& shape = a.get_shape();
+    if (shape.size() != 2 || shape[0] != shape[1]) return false;
+    size_t n = shape[0];
+    if (b.size() != n || x.size() != n) return false;
+    result = SolverResult();
+    const RoundingMode mode = config.mode;
+
+    Vector av = decode_all(a), bv = decode_all(b);
+    LUFactors factors{n, av, {}};
+    round_all(factors.lu, config.factor, mode);
+    if (!lu_factor(factors, config.factor, mode)) return false;
+
+    double b_norm = 0.0;
+    for (double v : bv) b_norm += v * v;
+    b_norm = std::sqrt(b_norm);
+
+    Vector xv = lu_solve(factors, bv, config.factor, mode);
+    round_all(xv, config.update, mode);
+    Vector r(n);
+    for (;;) {
+        // r = b - A x, accumulated in the residual format
+        parallel_for(0, n, std::max<size_t>(1, block_size / n), [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; ++i) {
+                double acc = bv[i];
+                for (size_t j = 0; j < n; ++j)
+                    acc = round_sum(acc, -av[i * n + j] * xv[j], config.residual, mode);
+                r[i] = acc;
+            }
+        });
+        double r_norm = 0.0;
+        for (double v : r) r_norm += v * v;
+        double relative = b_norm == 0.0 ? std::sqrt(r_norm) : std::sqrt(r_norm) / b_norm;
+        result.residual_history.push_back(relative);
+        if (relative <= config.tolerance) {
+            result.converged = true;
+            break;
+        }
+        if (!std::isfinite(relative) || result.iterations >= config.max_iterations) break;
+
+        // scale the residual to unit max norm before the low-precision solve,
+        // so small residuals do not underflow into the factor format's
+        // subnormal range
+        double scale = 0.0;
+        for (double v : r) scale = std::max(scale, std::abs(v));
+        for (double& v : r) v /= scale;
+        Vector d = lu_solve(factors, r, config.factor, mode);
+        for (size_t i = 0; i < n; ++i) xv[i] = round_sum(xv[i], scale * d[i], config.update, mode);
+        ++result.iterations;
+    }
+
+    x.encode_range(0, n, xv.data(), mode);
+    return true;
+}
+
+void write_residual_history(std::ostream& out, const SolverResult& result) {
+    out << "iteration,relative_residual\n";
+    for (size_t i = 0; i < result.residual_history.size(); ++i)
+        out << i << ',' << result.residual_history[i] << '\n';
+}
+
+}
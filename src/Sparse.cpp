@@ -0,0 +1,198 @@
+#include "Sparse.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <utility>
+
+namespace CustomFP {
+
+// rows handed to one parallel_for chunk
+static constexpr size_t row_grain = 64;
+
+// CSR
+CsrMatrix::CsrMatrix(Format format, size_t rows, size_t cols, std::vector<Triplet> entries)
+    : rows(rows), cols(cols), values(format, 0), row_ptr(rows + 1, 0) {
+    std::sort(entries.begin(), entries.end(), [](const Triplet& x, const Triplet& y) {
+        return x.row != y.row ? x.row < y.row : x.col < y.col;
+    });
+    std::vector<Triplet> merged;
+    for (const auto& entry : entries) {
+        if (entry.row >= rows || entry.col >= cols) continue;
+        if (!merged.empty() && merged.back().row == entry.row && merged.back().col == entry.col)
+            merged.back().value += entry.value;
+        else
+            merged.push_back(entry);
+    }
+
+    values = Tensor(format, merged.size());
+    if (cols <= (1u << 16)) col_index16.resize(merged.size());
+    else col_index32.resize(merged.size());
+    for (size_t k = 0; k < merged.size(); ++k) {
+        values.set(k, merged[k].value);
+        set_col(k, merged[k].col);
+        row_ptr[merged[k].row + 1]++;
+    }
+    for (size_t r = 0; r < rows; ++r) row_ptr[r + 1] += row_ptr[r];
+}
+
+void CsrMatrix::set_col(size_t k, size_t col) {
+    if (col_index16.empty()) col_index32[k] = static_cast<uint32_t>(col);
+    else col_index16[k] = static_cast<uint16_t>(col);
+}
+
+CsrMatrix CsrMatrix::from_dense(const Tensor& dense) {
+    const auto& shape = dense.get_shape();
+    size_t rows = shape.size() == 2 ? shape[0] : 1;
+    size_t cols = shape.size() == 2 ? shape[1] : dense.size();
+    unsigned long long magnitude = (1ULL << (dense.get_format().get_total_bits() - 1)) - 1;
+    std::vector<Triplet> entries;
+    for (size_t i = 0; i < dense.size(); ++i) {
+        if (dense.get_bits(i) & magnitude) entries.push_back(Triplet{i / cols, i % cols, dense.get(i)});
+    }
+    return CsrMatrix(dense.get_format(), rows, cols, std::move(entries));
+}
+
+// N:M structured
+StructuredSparseMatrix::StructuredSparseMatrix(const Tensor& dense, unsigned n, unsigned m)
+    : rows(dense.get_shape().size() == 2 ? dense.get_shape()[0] : 1),
+      cols(dense.get_shape().size() == 2 ? dense.get_shape()[1] : dense.size()),
+      n(std::max(1u, std::min(n, m))), m(std::max(1u, m)), index_bits(0),
+      values(dense.get_format(), 0) {
+    while ((1u << index_bits) < this->m) ++index_bits;
+    size_t groups = get_groups();
+    size_t kept = rows * groups * this->n;
+    values = Tensor(dense.get_format(), kept);
+    metadata.assign((kept * index_bits + 7) / 8 + 1, 0);
+
+    unsigned long long magnitude = (1ULL << (dense.get_format().get_total_bits() - 1)) - 1;
+    std::vector<unsigned> positions;
+    for (size_t r = 0; r < rows; ++r) {
+        for (size_t g = 0; g < groups; ++g) {
+            size_t base = r * cols + g * this->m;
+            unsigned available = static_cast<unsigned>(std::min<size_t>(this->m, cols - g * this->m));
+            positions.resize(available);
+            for (unsigned p = 0; p < available; ++p) positions[p] = p;
+            // largest magnitudes first, earlier positions win ties
+            std::stable_sort(positions.begin(), positions.end(), [&](unsigned x, unsigned y) {
+                return (dense.get_bits(base + x) & magnitude) > (dense.get_bits(base + y) & magnitude);
+            });
+            positions.resize(std::min(available, this->n));
+            std::sort(positions.begin(), positions.end());
+
+            size_t k = (r * groups + g) * this->n;
+            for (unsigned slot = 0; slot < positions.size(); ++slot) {
+                values.set_bits(k + slot, dense.get_bits(base + positions[slot]));
+                set_position(k + slot, positions[slot]);
+            }
+        }
+    }
+}
+
+void StructuredSparseMatrix::set_position(size_t k, unsigned position) {
+    size_t bit = k * index_bits;
+    for (unsigned i = 0; i < index_bits; ++i, ++bit) {
+        if (position & (1u << i)) metadata[bit / 8] |= static_cast<uint8_t>(1u << (bit % 8));
+    }
+}
+
+size_t StructuredSparseMatrix::get_col(size_t k) const {
+    size_t bit = k * index_bits;
+    unsigned window = metadata[bit / 8] | (metadata[bit / 8 + 1] << 8);
+    unsigned position = (window >> (bit % 8)) & ((1u << index_bits) - 1);
+    size_t group = (k / n) % get_groups();
+    return group * m + position;
+}
+
+// Kernels
+static std::pair<size_t, size_t> row_range(const CsrMatrix& a, size_t row) {
+    return {a.get_row_ptr()[row], a.get_row_ptr()[row + 1]};
+}
+
+static std::pair<size_t, size_t> row_range(const StructuredSparseMatrix& a, size_t row) {
+    size_t per_row = a.get_groups() * a.get_n();
+    return {row * per_row, (row + 1) * per_row};
+}
+
+// structured values are zero padded: a zero slot is a pruned entry or the
+// padding of a short trailing group and, like a column missing from a CSR
+// row, is never multiplied
+static bool skip_slot(const CsrMatrix&, double) { return false; }
+static bool skip_slot(const StructuredSparseMatrix&, double value) { return value == 0.0; }
+
+static bool is_matrix(const Tensor& t, size_t rows, size_t cols) {
+    const auto& shape = t.get_shape();
+    return shape.size() == 2 && shape[0] == rows && shape[1] == cols;
+}
+
+template <typename Matrix>
+static bool spmv_impl(const Matrix& a, const Tensor& x, Tensor& y, const AccumulatorConfig& config) {
+    if (x.size() != a.get_cols() || y.size() != a.get_rows()) return false;
+    std::vector<double> xv(x.size());
+    x.decode_range(0, x.size(), xv.data());
+
+    parallel_for(0, a.get_rows(), row_grain, [&](size_t first, size_t last) {
+        std::vector<double> row_values;
+        std::vector<double> out(last - first);
+        for (size_t r = first; r < last; ++r) {
+            auto range = row_range(a, r);
+            row_values.resize(range.second - range.first);
+            a.get_values().decode_range(range.first, range.second, row_values.data());
+            double acc = 0.0;
+            for (size_t k = range.first; k < range.second; ++k) {
+                double v = row_values[k - range.first];
+                if (skip_slot(a, v)) continue;
+                acc = round_sum(acc, v * xv[a.get_col(k)], config.accumulator, config.mode);
+            }
+            out[r - first] = acc;
+        }
+        y.encode_range(first, last, out.data(), config.mode);
+    });
+    return true;
+}
+
+template <typename Matrix>
+static bool spmm_impl(const Matrix& a, const Tensor& b, Tensor& c, const AccumulatorConfig& config) {
+    if (b.get_shape().size() != 2) return false;
+    size_t n = b.get_shape()[1];
+    if (!is_matrix(b, a.get_cols(), n) || !is_matrix(c, a.get_rows(), n)) return false;
+    std::vector<double> bv(b.size());
+    b.decode_range(0, b.size(), bv.data());
+
+    parallel_for(0, a.get_rows(), std::max<size_t>(1, row_grain / std::max<size_t>(n, 1)),
+                 [&](size_t first, size_t last) {
+        std::vector<double> row_values;
+        std::vector<double> acc(n);
+        for (size_t r = first; r < last; ++r) {
+            auto range = row_range(a, r);
+            row_values.resize(range.second - range.first);
+            a.get_values().decode_range(range.first, range.second, row_values.data());
+            std::fill(acc.begin(), acc.end(), 0.0);
+            for (size_t k = range.first; k < range.second; ++k) {
+                double v = row_values[k - range.first];
+                if (skip_slot(a, v)) continue;
+                const double* b_row = bv.data() + a.get_col(k) * n;
+                for (size_t j = 0; j < n; ++j)
+                    acc[j] = round_sum(acc[j], v * b_row[j], config.accumulator, config.mode);
+            }
+            c.encode_range(r * n, (r + 1) * n, acc.data(), config.mode);
+        }
+    });
+    return true;
+}
+
+bool spmv(const CsrMatrix& a, const Tensor& x, Tensor& y, const AccumulatorConfig& config) {
+    return spmv_impl(a, x, y, config);
+}
+
+bool spmv(const StructuredSparseMatrix& a, const Tensor& x, Tensor& y, const AccumulatorConfig& config) {
+    return spmv_impl(a, x, y, config);
+}
+
+bool spmm(const CsrMatrix& a, const Tensor& b, Tensor& c, const AccumulatorConfig& config) {
+    return spmm_impl(a, b, c, config);
+}
+
+bool spmm(const StructuredSparseMatrix& a, const Tensor& b, Tensor& c, const AccumulatorConfig& config) {
+    return spmm_impl(a, b, c, config);
+}
+
+}
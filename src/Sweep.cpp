@@ -0,0 +1,334 @@
+#include "Sweep.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <tuple>
+
+namespace CustomFP {
+
+// rows of a GEMM emulated per task
+static constexpr size_t gemm_rows_per_task = 8;
+
+// Loading
+static bool next_token(std::istream& in, std::string& token) {
+    while (in >> token) {
+        if (token[0] != '#') return true;
+        std::string rest;
+        std::getline(in, rest);
+    }
+    return false;
+}
+
+template <typename T>
+static bool next_value(std::istream& in, T& value) {
+    std::string token;
+    if (!next_token(in, token)) return false;
+    std::istringstream parser(token);
+    return static_cast<bool>(parser >> value) && parser.eof();
+}
+
+static bool read_values(std::istream& in, size_t count, std::vector<double>& values) {
+    values.resize(count);
+    for (auto& v : values)
+        if (!next_value(in, v)) return false;
+    return true;
+}
+
+bool load_workload(std::istream& in, Workload& workload) {
+    workload.ops.clear();
+    std::string kind;
+    while (next_token(in, kind)) {
+        WorkloadOp op{};
+        if (kind == "dot") {
+            op.kind = WorkloadOp::Kind::dot;
+            if (!next_value(in, op.n)) return false;
+            op.m = op.k = 1;
+            if (!read_values(in, op.n, op.a) || !read_values(in, op.n, op.b)) return false;
+        } else if (kind == "gemm") {
+            op.kind = WorkloadOp::Kind::gemm;
+            if (!next_value(in, op.m) || !next_value(in, op.n) || !next_value(in, op.k)) return false;
+            if (!read_values(in, op.m * op.k, op.a) || !read_values(in, op.k * op.n, op.b)) return false;
+        } else if (kind == "reduce") {
+            op.kind = WorkloadOp::Kind::reduce;
+            if (!next_value(in, op.n)) return false;
+            op.m = op.k = 1;
+            if (!read_values(in, op.n, op.a)) return false;
+        } else {
+            return false;
+        }
+        workload.ops.push_back(std::move(op));
+    }
+    return true;
+}
+
+bool load_workload(const std::string& path, Workload& workload) {
+    std::ifstream in(path);
+    if (!in) return false;
+    return load_workload(in, workload);
+}
+
+// Names
+bool parse_format(const std::string& name, Format& format) {
+    unsigned e = 0, m = 0;
+    char tail;
+    if (std::sscanf(name.c_str(), "e%um%u%c", &e, &m, &tail) != 2) return false;
+    if (e < 2 || e > 11 || m > 52) return false;
+    format = Format{e, m};
+    return true;
+}
+
+std::string format_name(Format format) {
+    return "e" + std::to_string(format.exponent_bits) + "m" + std::to_string(format.mantissa_bits);
+}
+
+bool parse_rounding(const std::string& name, RoundingMode& mode) {
+    if (name == "rne") mode = RoundingMode::nearest_even;
+    else if (name == "rtz") mode = RoundingMode::toward_zero;
+    else if (name == "rup") mode = RoundingMode::toward_pos_inf;
+    else if (name == "rdn") mode = RoundingMode::toward_neg_inf;
+    else return false;
+    return true;
+}
+
+std::string rounding_name(RoundingMode mode) {
+    switch (mode) {
+        case RoundingMode::toward_zero: return "rtz";
+        case RoundingMode::toward_pos_inf: return "rup";
+        case RoundingMode::toward_neg_inf: return "rdn";
+        case RoundingMode::nearest_even:
+        default: return "rne";
+    }
+}
+
+std::vector<SweepConfig> make_grid(const std::vector<Format>& inputs,
+                                   const std::vector<Format>& accumulators,
+                                   const std::vector<RoundingMode>& modes) {
+    std::vector<SweepConfig> grid;
+    for (const auto& input : inputs)
+        for (const auto& accumulator : accumulators)
+            for (auto mode : modes)
+                grid.push_back(SweepConfig{input, accumulator, mode});
+    return grid;
+}
+
+// Cost model
+// array multiplier grows with the square of the significand, the
+// accumulator adder and its alignment shifter with width * log(width)
+static double mac_area(Format input, Format accumulator) {
+    double mi = input.mantissa_bits + 1.0;
+    double ma = accumulator.mantissa_bits + 1.0;
+    return mi * mi + ma * std::log2(ma + 1.0) + input.exponent_bits + accumulator.exponent_bits;
+}
+
+// Emulation
+// sum of a[i] * b[i * stride] with the running sum rounded at every step;
+// b == nullptr sums a alone
+static double accumulate(const double* a, const double* b, size_t count, size_t stride,
+                         Format accumulator, RoundingMode mode) {
+    double acc = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        if (!b) {
+            acc = round_sum(acc, a[i], accumulator, mode);
+            continue;
+        }
+        // the product and its fma error term are exact; acc + product + error
+        // is resolved to a double and a residual before the single rounding
+        double product = a[i] * b[i * stride];
+        double error = std::isfinite(product) ? std::fma(a[i], b[i * stride], -product) : 0.0;
+        double sum = acc + product;
+        if (!std::isfinite(sum) || error == 0.0) {
+            acc = round_sum(acc, product, accumulator, mode);
+            continue;
+        }
+        double product_part = sum - acc;
+        double tail = (acc - (sum - product_part)) + (product - product_part) + error;
+        double value = sum + tail;
+        acc = round_sum(value, tail - (value - sum), accumulator, mode);
+    }
+    return acc;
+}
+
+// kept in long double so an error below one double ulp of the result still shows
+static long double exact_sum(const double* a, const double* b, size_t count, size_t stride) {
+    long double acc = 0.0L;
+    for (size_t i = 0; i < count; ++i)
+        acc += b ? static_cast<long double>(a[i]) * b[i * stride] : a[i];
+    return acc;
+}
+
+// outputs [first_row, last_row) of op; rows are only meaningful for gemm
+template <typename Kernel>
+static void for_each_output(const WorkloadOp& op, const std::vector<double>& a, const std::vector<double>& b,
+                            size_t first_row, size_t last_row, Kernel kernel) {
+    switch (op.kind) {
+        case WorkloadOp::Kind::dot:
+            kernel(0, a.data(), b.data(), op.n, 1);
+            break;
+        case WorkloadOp::Kind::reduce:
+            kernel(0, a.data(), nullptr, op.n, 1);
+            break;
+        case WorkloadOp::Kind::gemm:
+            for (size_t row = first_row; row < last_row; ++row)
+                for (size_t col = 0; col < op.n; ++col)
+                    kernel(row * op.n + col, a.data() + row * op.k, b.data() + col, op.k, op.n);
+            break;
+    }
+}
+
+struct ErrorStats {
+    size_t outputs = 0;
+    size_t non_finite = 0;
+    double max_abs = 0.0;
+    double sum_rel = 0.0;
+    double max_rel = 0.0;
+
+    void add(double value, long double reference) {
+        ++outputs;
+        if (!std::isfinite(value) && std::isfinite(reference)) {
+            ++non_finite;
+            return;
+        }
+        long double difference = std::fabs(value - reference);
+        double abs_error = static_cast<double>(difference);
+        double rel_error = static_cast<double>(reference != 0.0L ? difference / std::fabs(reference) : difference);
+        max_abs = std::max(max_abs, abs_error);
+        max_rel = std::max(max_rel, rel_error);
+        sum_rel += rel_error;
+    }
+
+    void merge(const ErrorStats& other) {
+        outputs += other.outputs;
+        non_finite += other.non_finite;
+        max_abs = std::max(max_abs, other.max_abs);
+        max_rel = std::max(max_rel, other.max_rel);
+        sum_rel += other.sum_rel;
+    }
+};
+
+// operands of every op rounded to one input format
+struct RoundedInputs {
+    std::vector<std::vector<double>> a;
+    std::vector<std::vector<double>> b;
+};
+
+std::vector<SweepResult> run_sweep(const Workload& workload,
+                                   const std::vector<SweepConfig>& configs,
+                                   ThreadPool& pool) {
+    const auto& ops = workload.ops;
+
+    // phase 1: reference results and rounded inputs, each computed once
+    std::vector<std::vector<long double>> references(ops.size());
+    std::map<std::tuple<unsigned, unsigned, int>, RoundedInputs> rounded;
+    for (const auto& config : configs) {
+        auto& inputs = rounded[{config.input.exponent_bits, config.input.mantissa_bits,
+                                static_cast<int>(config.mode)}];
+        inputs.a.resize(ops.size());
+        inputs.b.resize(ops.size());
+    }
+
+    TaskGroup prepare;
+    for (size_t i = 0; i < ops.size(); ++i) {
+        pool.submit(prepare, [&, i] {
+            const WorkloadOp& op = ops[i];
+            references[i].resize(op.m * (op.kind == WorkloadOp::Kind::gemm ? op.n : 1));
+            for_each_output(op, op.a, op.b, 0, op.m,
+                            [&](size_t out, const double* a, const double* b, size_t count, size_t stride) {
+                                references[i][out] = exact_sum(a, b, count, stride);
+                            });
+        });
+        for (auto& entry : rounded) {
+            Format format{std::get<0>(entry.first), std::get<1>(entry.first)};
+            RoundingMode mode = static_cast<RoundingMode>(std::get<2>(entry.first));
+            RoundedInputs* inputs = &entry.second;
+            pool.submit(prepare, [&ops, i, format, mode, inputs] {
+                auto round_all = [&](const std::vector<double>& in, std::vector<double>& out) {
+                    out.resize(in.size());
+                    for (size_t j = 0; j < in.size(); ++j) out[j] = round_value(in[j], format, mode);
+                };
+                round_all(ops[i].a, inputs->a[i]);
+                round_all(ops[i].b, inputs->b[i]);
+            });
+        }
+    }
+    pool.wait(prepare);
+
+    // phase 2: one task per (config, op), GEMMs split into row blocks so a
+    // large op does not serialize the tail of the sweep
+    struct Task {
+        size_t config;
+        size_t op;
+        size_t first_row;
+        size_t last_row;
+    };
+    std::vector<Task> tasks;
+    for (size_t c = 0; c < configs.size(); ++c) {
+        for (size_t i = 0; i < ops.size(); ++i) {
+            size_t rows = ops[i].kind == WorkloadOp::Kind::gemm ? ops[i].m : 1;
+            for (size_t row = 0; row < rows; row += gemm_rows_per_task)
+                tasks.push_back(Task{c, i, row, std::min(rows, row + gemm_rows_per_task)});
+        }
+    }
+
+    std::vector<ErrorStats> partial(tasks.size());
+    TaskGroup emulate;
+    for (size_t t = 0; t < tasks.size(); ++t) {
+        pool.submit(emulate, [&, t] {
+            const Task& task = tasks[t];
+            const SweepConfig& config = configs[task.config];
+            const auto& inputs = rounded.at({config.input.exponent_bits, config.input.mantissa_bits,
+                                             static_cast<int>(config.mode)});
+            for_each_output(ops[task.op], inputs.a[task.op], inputs.b[task.op], task.first_row, task.last_row,
+                            [&](size_t out, const double* a, const double* b, size_t count, size_t stride) {
+                                double value = accumulate(a, b, count, stride, config.accumulator, config.mode);
+                                partial[t].add(value, references[task.op][out]);
+                            });
+        });
+    }
+    pool.wait(emulate);
+
+    std::vector<ErrorStats> totals(configs.size());
+    for (size_t t = 0; t < tasks.size(); ++t) totals[tasks[t].config].merge(partial[t]);
+
+    const double fp32_area = mac_area(Format{8, 23}, Format{8, 23});
+    std::vector<SweepResult> results;
+    for (size_t c = 0; c < configs.size(); ++c) {
+        const ErrorStats& stats = totals[c];
+        SweepResult result{};
+        result.config = configs[c];
+        result.outputs = stats.outputs;
+        result.non_finite = stats.non_finite;
+        result.max_abs_error = stats.max_abs;
+        result.max_rel_error = stats.max_rel;
+        size_t finite = stats.outputs - stats.non_finite;
+        result.mean_rel_error = finite ? stats.sum_rel / static_cast<double>(finite) : 0.0;
+        result.bits = configs[c].input.get_total_bits();
+        result.area = mac_area(configs[c].input, configs[c].accumulator) / fp32_area;
+        // half arithmetic, half operand traffic
+        result.energy = 0.5 * result.area + 0.5 * result.bits / 32.0;
+        results.push_back(result);
+    }
+    return results;
+}
+
+void write_table(std::ostream& out, const std::vector<SweepResult>& results) {
+    out << "input,accumulator,rounding,bits,area,energy,max_abs_error,mean_rel_error,max_rel_error,non_finite,outputs\n";
+    for (const auto& r : results) {
+        out << format_name(r.config.input) << ','
+            << format_name(r.config.accumulator) << ','
+            << rounding_name(r.config.mode) << ','
+            << r.bits << ','
+            << std::setprecision(4) << r.area << ','
+            << r.energy << ','
+            << std::setprecision(6) << r.max_abs_error << ','
+            << r.mean_rel_error << ','
+            << r.max_rel_error << ','
+            << r.non_finite << ','
+            << r.outputs << '\n';
+    }
+}
+
+}
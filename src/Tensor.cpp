@@ -0,0 +1,75 @@
+#include "Tensor.hpp"
+#include <numeric>
+
+namespace CustomFP {
+
+static unsigned storage_bytes(Format format) {
+    unsigned bits = format.get_total_bits();
+    if (bits <= 8) return 1;
+    if (bits <= 16) return 2;
+    if (bits <= 32) return 4;
+    return 8;
+}
+
+Tensor::Tensor(Format format, std::vector<size_t> shape)
+    : format(format), shape(std::move(shape)), element_bytes(storage_bytes(format)) {
+    size_t count = std::accumulate(this->shape.begin(), this->shape.end(),
+                                   static_cast<size_t>(1), std::multiplies<size_t>());
+    storage.assign(count * element_bytes, 0);
+}
+
+Tensor::Tensor(Format format, size_t size)
+    : Tensor(format, std::vector<size_t>{size}) {}
+
+unsigned long long Tensor::get_bits(size_t i) const {
+    switch (element_bytes) {
+        case 1: return data<uint8_t>()[i];
+        case 2: return data<uint16_t>()[i];
+        case 4: return data<uint32_t>()[i];
+        default: return data<uint64_t>()[i];
+    }
+}
+
+void Tensor::set_bits(size_t i, unsigned long long raw) {
+    switch (element_bytes) {
+        case 1: data<uint8_t>()[i] = static_cast<uint8_t>(raw); break;
+        case 2: data<uint16_t>()[i] = static_cast<uint16_t>(raw); break;
+        case 4: data<uint32_t>()[i] = static_cast<uint32_t>(raw); break;
+        default: data<uint64_t>()[i] = raw; break;
+    }
+}
+
+ExMy Tensor::get_exmy(size_t i) const {
+    ExMy value(1, format.exponent_bits, format.mantissa_bits);
+    value.set_bits(get_bits(i));
+    return value;
+}
+
+void Tensor::set_exmy(size_t i, const ExMy& value) {
+    set_bits(i, value.get_raw_bits());
+}
+
+template <typename T>
+static void decode_typed(const T* in, size_t count, Format format, double* out) {
+    if (const double* table = decode_table(format)) {
+        for (size_t i = 0; i < count; ++i) out[i] = table[in[i]];
+    } else {
+        for (size_t i = 0; i < count; ++i) out[i] = decode(in[i], format);
+    }
+}
+
+void Tensor::decode_range(size_t begin, size_t end, double* out) const {
+    size_t count = end - begin;
+    switch (element_bytes) {
+        case 1: decode_typed(data<uint8_t>() + begin, count, format, out); break;
+        case 2: decode_typed(data<uint16_t>() + begin, count, format, out); break;
+        case 4: decode_typed(data<uint32_t>() + begin, count, format, out); break;
+        default: decode_typed(data<uint64_t>() + begin, count, format, out); break;
+    }
+}
+
+void Tensor::encode_range(size_t begin, size_t end, const double* in, RoundingMode mode) {
+    for (size_t i = begin; i < end; ++i) set_bits(i, encode(in[i - begin], format, mode));
+}
+
+}
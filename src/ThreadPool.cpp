@@ -0,0 +1,161 @@
+#include "ThreadPool.hpp"
+#include <algorithm>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#ifndef FLEXFLOAT_PIN_THREADS
+#define FLEXFLOAT_PIN_THREADS 0
+#endif
+
+namespace CustomFP {
+
+// pool and queue owned by the current worker thread, if any
+static thread_local const ThreadPool* worker_pool = nullptr;
+static thread_local size_t worker_queue = 0;
+
+// bind thread to the index-th CPU of the process affinity mask
+static bool pin_thread(std::thread& thread, size_t index) {
+#ifdef __linux__
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0) return false;
+    size_t target = index % static_cast<size_t>(CPU_COUNT(&allowed));
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (!CPU_ISSET(cpu, &allowed) || target-- != 0) continue;
+        cpu_set_t single;
+        CPU_ZERO(&single);
+        CPU_SET(cpu, &single);
+        return pthread_setaffinity_np(thread.native_handle(), sizeof(single), &single) == 0;
+    }
+    return false;
+#else
+    (void)thread;
+    (void)index;
+    return false;
+#endif
+}
+
+ThreadPool::ThreadPool(unsigned num_threads, bool pin_threads) : stopping(false), pinned(false) {
+    if (num_threads == 0) num_threads = std::max(1u, std::thread::hardware_concurrency());
+    // a pool without workers has nothing to pin
+    pinned = pin_threads && num_threads > 1;
+    for (unsigned i = 0; i < num_threads; ++i) queues.push_back(std::make_unique<Queue>());
+    for (unsigned i = 1; i < num_threads; ++i) {
+        workers.emplace_back(&ThreadPool::worker_loop, this, static_cast<size_t>(i));
+        // index 0 belongs to the calling thread, which keeps its own affinity
+        if (pin_threads && !pin_thread(workers.back(), i)) pinned = false;
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) worker.join();
+}
+
+ThreadPool& ThreadPool::global() {
+    static ThreadPool pool(0, FLEXFLOAT_PIN_THREADS != 0);
+    return pool;
+}
+
+size_t ThreadPool::current_queue() const {
+    return worker_pool == this ? worker_queue : 0;
+}
+
+bool ThreadPool::run_one(size_t home) {
+    std::function<void()> task;
+    for (size_t offset = 0; offset < queues.size() && !task; ++offset) {
+        Queue& queue = *queues[(home + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) continue;
+        if (offset == 0) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+    }
+    if (!task) return false;
+    queued.fetch_sub(1, std::memory_order_relaxed);
+    task();
+    return true;
+}
+
+void ThreadPool::worker_loop(size_t index) {
+    worker_pool = this;
+    worker_queue = index;
+    while (true) {
+        if (run_one(index)) continue;
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        wake.wait(lock, [&] { return stopping || queued.load(std::memory_order_relaxed) > 0; });
+        if (stopping) return;
+    }
+}
+
+void ThreadPool::submit(TaskGroup& group, std::function<void()> task) {
+    group.pending.fetch_add(1, std::memory_order_relaxed);
+    Queue& queue = *queues[current_queue()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back([this, &group, task = std::move(task)] {
+            task();
+            // group may be gone once pending reaches 0; only the pool is touched after
+            if (group.pending.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+            {
+                std::lock_guard<std::mutex> lock(sleep_mutex);
+            }
+            wake.notify_all();
+        });
+    }
+    queued.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+    }
+    wake.notify_one();
+}
+
+void ThreadPool::wait(TaskGroup& group) {
+    size_t home = current_queue();
+    while (!group.done()) {
+        if (run_one(home)) continue;
+        // nothing to steal: sleep until a task is queued or the group finishes
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        wake.wait(lock, [&] { return group.done() || queued.load(std::memory_order_relaxed) > 0; });
+    }
+}
+
+void ThreadPool::parallel_for(size_t begin, size_t end, size_t grain,
+                              const std::function<void(size_t, size_t)>& body) {
+    if (end <= begin) return;
+    grain = std::max<size_t>(grain, 1);
+    size_t count = end - begin;
+    if (workers.empty() || count <= grain) {
+        body(begin, end);
+        return;
+    }
+
+    // a few chunks per thread keeps the tail short without shrinking below grain
+    size_t target_chunks = static_cast<size_t>(get_num_threads()) * 4;
+    size_t chunk = std::max(grain, (count + target_chunks - 1) / target_chunks);
+
+    TaskGroup group;
+    for (size_t first = begin + chunk; first < end; first += chunk) {
+        size_t last = std::min(end, first + chunk);
+        submit(group, [&body, first, last] { body(first, last); });
+    }
+    body(begin, std::min(end, begin + chunk));
+    wait(group);
+}
+
+void parallel_for(size_t begin, size_t end, size_t grain,
+                  const std::function<void(size_t, size_t)>& body) {
+    ThreadPool::global().parallel_for(begin, end, grain, body);
+}
+
+}
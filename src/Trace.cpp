@@ -0,0 +1,291 @@
+#include "Trace.hpp"
+#include "Ordering.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace CustomFP {
+
+static const char trace_magic[4] = {'F', 'F', 'T', 'R'};
+static constexpr uint32_t trace_version = 1;
+
+namespace detail {
+std::atomic<bool> trace_active{false};
+}
+
+// single-producer single-consumer ring; head is written by the owning
+// thread, tail by the drain thread
+struct TraceRing {
+    std::vector<TraceRecord> slots;
+    size_t mask;
+    uint32_t thread;
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+};
+
+struct TraceState {
+    std::mutex mutex;                                   // rings, file, session
+    std::vector<std::unique_ptr<TraceRing>> rings;
+    std::vector<TraceRing*> released;
+    size_t ring_records = 1 << 16;
+    std::FILE* file = nullptr;
+    std::thread drainer;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::atomic<unsigned long long> session{0};
+};
+
+// never destroyed: threads exiting during static destruction still hand
+// their rings back
+static TraceState& state() {
+    static TraceState* instance = new TraceState;
+    return *instance;
+}
+
+// writes everything published so far; caller holds state().mutex
+static void drain_rings(TraceState& st) {
+    for (auto& ring : st.rings) {
+        size_t tail = ring->tail.load(std::memory_order_relaxed);
+        size_t head = ring->head.load(std::memory_order_acquire);
+        if (head == tail) continue;
+        uint32_t header[2] = {ring->thread, static_cast<uint32_t>(head - tail)};
+        std::fwrite(header, sizeof(header), 1, st.file);
+        size_t first = tail & ring->mask;
+        size_t count = head - tail;
+        size_t until_wrap = std::min(count, ring->slots.size() - first);
+        std::fwrite(ring->slots.data() + first, sizeof(TraceRecord), until_wrap, st.file);
+        std::fwrite(ring->slots.data(), sizeof(TraceRecord), count - until_wrap, st.file);
+        ring->tail.store(head, std::memory_order_release);
+    }
+}
+
+static void drain_loop() {
+    TraceState& st = state();
+    std::unique_lock<std::mutex> lock(st.mutex);
+    while (!st.stopping) {
+        drain_rings(st);
+        st.wake.wait_for(lock, std::chrono::milliseconds(1));
+    }
+    drain_rings(st);
+}
+
+bool trace_start(const std::string& path, size_t ring_records) {
+    TraceState& st = state();
+    trace_stop();
+    std::lock_guard<std::mutex> lock(st.mutex);
+    st.file = std::fopen(path.c_str(), "wb");
+    if (!st.file) return false;
+    std::setvbuf(st.file, nullptr, _IOFBF, 1 << 20);
+    std::fwrite(trace_magic, sizeof(trace_magic), 1, st.file);
+    std::fwrite(&trace_version, sizeof(trace_version), 1, st.file);
+
+    // ring sizes are powers of two so positions wrap with a mask
+    size_t capacity = 1;
+    while (capacity < ring_records) capacity <<= 1;
+    st.ring_records = capacity;
+    for (auto& ring : st.rings) {
+        ring->head.store(0, std::memory_order_relaxed);
+        ring->tail.store(0, std::memory_order_relaxed);
+    }
+    st.session.fetch_add(1, std::memory_order_release);
+    st.stopping = false;
+    st.drainer = std::thread(drain_loop);
+    detail::trace_active.store(true, std::memory_order_release);
+    return true;
+}
+
+void trace_stop() {
+    TraceState& st = state();
+    detail::trace_active.store(false, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(st.mutex);
+        if (!st.file) return;
+        st.stopping = true;
+    }
+    st.wake.notify_all();
+    st.drainer.join();
+    std::lock_guard<std::mutex> lock(st.mutex);
+    std::fclose(st.file);
+    st.file = nullptr;
+}
+
+// a trace left running at exit is still flushed
+static struct TraceExitFlush {
+    ~TraceExitFlush() { trace_stop(); }
+} trace_exit_flush;
+
+// ring of the calling thread, handed back for reuse when the thread exits
+struct RingHandle {
+    TraceRing* ring = nullptr;
+    unsigned long long session = 0;
+
+    ~RingHandle() {
+        if (!ring) return;
+        std::lock_guard<std::mutex> lock(state().mutex);
+        state().released.push_back(ring);
+    }
+
+    TraceRing& get() {
+        TraceState& st = state();
+        if (ring && session == st.session.load(std::memory_order_acquire)) return *ring;
+        std::lock_guard<std::mutex> lock(st.mutex);
+        if (!ring) {
+            if (!st.released.empty()) {
+                ring = st.released.back();
+                st.released.pop_back();
+            } else {
+                st.rings.push_back(std::make_unique<TraceRing>());
+                ring = st.rings.back().get();
+                ring->thread = static_cast<uint32_t>(st.rings.size() - 1);
+            }
+        }
+        // rings are resized only between sessions, when they are empty
+        if (ring->slots.size() != st.ring_records) {
+            ring->slots.assign(st.ring_records, TraceRecord{});
+            ring->mask = st.ring_records - 1;
+        }
+        session = st.session.load(std::memory_order_relaxed);
+        return *ring;
+    }
+};
+
+void trace_record(const TraceRecord& record) {
+    static thread_local RingHandle handle;
+    TraceRing& ring = handle.get();
+    size_t head = ring.head.load(std::memory_order_relaxed);
+    while (head - ring.tail.load(std::memory_order_acquire) == ring.slots.size()) {
+        state().wake.notify_one();
+        std::this_thread::yield();
+    }
+    ring.slots[head & ring.mask] = record;
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+TraceScope::TraceScope(OpKind op, const ExMy& a, const ExMy& b, const ExMy& result)
+    : active(trace_enabled()), record(), result(&result) {
+    if (!active) return;
+    record.op = static_cast<uint8_t>(op);
+    record.a_exponent_bits = static_cast<uint8_t>(a.get_exponent_bits());
+    record.a_mantissa_bits = static_cast<uint8_t>(a.get_mantissa_bits());
+    record.b_exponent_bits = static_cast<uint8_t>(b.get_exponent_bits());
+    record.b_mantissa_bits = static_cast<uint8_t>(b.get_mantissa_bits());
+    record.result_exponent_bits = static_cast<uint8_t>(result.get_exponent_bits());
+    record.result_mantissa_bits = static_cast<uint8_t>(result.get_mantissa_bits());
+    record.a = a.get_raw_bits();
+    record.b = b.get_raw_bits();
+}
+
+TraceScope::~TraceScope() {
+    if (!active) return;
+    record.result = result->get_raw_bits();
+    record.flags = static_cast<uint8_t>(result->status);
+    trace_record(record);
+}
+
+// Reading
+// calls visit(thread, record) for every record; false on a malformed file
+template <typename Visitor>
+static bool visit_trace(const std::string& path, Visitor visit) {
+    std::unique_ptr<std::FILE, int (*)(std::FILE*)> file(std::fopen(path.c_str(), "rb"), std::fclose);
+    if (!file) return false;
+    char magic[4];
+    uint32_t version = 0;
+    if (std::fread(magic, sizeof(magic), 1, file.get()) != 1 ||
+        std::fread(&version, sizeof(version), 1, file.get()) != 1 ||
+        std::memcmp(magic, trace_magic, sizeof(magic)) != 0 || version != trace_version)
+        return false;
+
+    std::vector<TraceRecord> chunk;
+    uint32_t header[2];
+    while (std::fread(header, sizeof(header), 1, file.get()) == 1) {
+        chunk.resize(header[1]);
+        if (std::fread(chunk.data(), sizeof(TraceRecord), chunk.size(), file.get()) != chunk.size())
+            return false;
+        for (const auto& record : chunk)
+            if (!visit(header[0], record)) return true;
+    }
+    return true;
+}
+
+bool read_trace(const std::string& path, std::vector<TraceRecord>& records) {
+    records.clear();
+    return visit_trace(path, [&](uint32_t, const TraceRecord& record) {
+        records.push_back(record);
+        return true;
+    });
+}
+
+// Replay
+ReplayBackend operator_backend() {
+    return [](const TraceRecord& r) -> unsigned long long {
+        ExMy a(1, r.a_exponent_bits, r.a_mantissa_bits);
+        ExMy b(1, r.b_exponent_bits, r.b_mantissa_bits);
+        ExMy result(1, r.result_exponent_bits, r.result_mantissa_bits);
+        a.set_bits(r.a);
+        b.set_bits(r.b);
+        switch (static_cast<OpKind>(r.op)) {
+            case OpKind::add: Adder().add(&a, &b, &result); break;
+            case OpKind::subtract: Subtractor().subtract(&a, &b, &result); break;
+            case OpKind::multiply: Multiplier().mul(&a, &b, &result); break;
+            case OpKind::divide: Divider().divide(&a, &b, &result); break;
+            default: break;
+        }
+        return result.get_raw_bits();
+    };
+}
+
+ReplayBackend reference_backend(RoundingMode mode) {
+    return [mode](const TraceRecord& r) -> unsigned long long {
+        double a = decode(r.a, Format{r.a_exponent_bits, r.a_mantissa_bits});
+        double b = decode(r.b, Format{r.b_exponent_bits, r.b_mantissa_bits});
+        Format format{r.result_exponent_bits, r.result_mantissa_bits};
+        // each value is the rounded double plus its error term, which
+        // round_sum resolves without a second rounding
+        double value = 0.0;
+        switch (static_cast<OpKind>(r.op)) {
+            case OpKind::add: value = round_sum(a, b, format, mode); break;
+            case OpKind::subtract: value = round_sum(a, -b, format, mode); break;
+            case OpKind::multiply: {
+                double product = a * b;
+                double error = std::isfinite(product) ? std::fma(a, b, -product) : 0.0;
+                value = round_sum(product, error, format, mode);
+                break;
+            }
+            case OpKind::divide: {
+                double quotient = a / b;
+                // the remainder a - quotient * b is exact; divided by b it
+                // gives the sign and size of the tail
+                bool finite = std::isfinite(quotient) && std::isfinite(b);
+                double tail = finite ? std::fma(-quotient, b, a) / b : 0.0;
+                value = round_sum(quotient, tail, format, mode);
+                break;
+            }
+            default: break;
+        }
+        return encode(value, format, mode);
+    };
+}
+
+bool replay_trace(const std::string& path, const ReplayBackend& backend, Divergence& divergence) {
+    divergence = Divergence{};
+    size_t index = 0;
+    return visit_trace(path, [&](uint32_t thread, const TraceRecord& record) {
+        unsigned long long replayed = backend(record);
+        Format format{record.result_exponent_bits, record.result_mantissa_bits};
+        bool both_nan = is_nan_bits(replayed, format) && is_nan_bits(record.result, format);
+        if (replayed != record.result && !both_nan) {
+            divergence = Divergence{true, index, thread, record, replayed};
+            return false;
+        }
+        ++index;
+        return true;
+    });
+}
+
+}
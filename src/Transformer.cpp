@@ -0,0 +1,231 @@
+#include "Transformer.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace CustomFP {
+
+// elements handed to one parallel_for chunk
+static constexpr size_t element_grain = 4096;
+
+static size_t row_length(const Tensor& t) {
+    const auto& shape = t.get_shape();
+    return shape.empty() ? t.size() : shape.back();
+}
+
+// runs body(row_values, row) on decoded rows of x and encodes the rows it
+// leaves in row_values into out
+template <typename Body>
+static void for_each_row(const Tensor& x, Tensor& out, size_t cols, RoundingMode mode, Body body) {
+    size_t rows = cols == 0 ? 0 : x.size() / cols;
+    parallel_for(0, rows, std::max<size_t>(1, element_grain / std::max<size_t>(cols, 1)),
+                 [&](size_t first, size_t last) {
+        std::vector<double> buffer(cols);
+        for (size_t r = first; r < last; ++r) {
+            x.decode_range(r * cols, (r + 1) * cols, buffer.data());
+            body(buffer.data(), r);
+            out.encode_range(r * cols, (r + 1) * cols, buffer.data(), mode);
+        }
+    });
+}
+
+// in-place softmax of n values; the weights are left rounded into result
+static void softmax_row(double* row, size_t n, const SoftmaxConfig& config, Format result) {
+    double max = -std::numeric_limits<double>::infinity();
+    for (size_t i = 0; i < n; ++i) max = std::max(max, row[i]);
+    if (std::isinf(max)) {
+        // all masked (or all +inf): spread the weight over the maxima
+        size_t count = 0;
+        for (size_t i = 0; i < n; ++i) count += row[i] == max;
+        for (size_t i = 0; i < n; ++i)
+            row[i] = row[i] == max ? round_value(1.0 / count, result, config.mode) : 0.0;
+        return;
+    }
+
+    double sum = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        double shifted = round_sum(row[i], -max, config.exponent, config.mode);
+        row[i] = round_value(std::exp(shifted), config.exponent, config.mode);
+        sum = round_sum(sum, row[i], config.accumulator, config.mode);
+    }
+    if (config.reciprocal) {
+        double inverse = round_value(1.0 / sum, config.accumulator, config.mode);
+        for (size_t i = 0; i < n; ++i) row[i] = round_value(row[i] * inverse, result, config.mode);
+    } else {
+        for (size_t i = 0; i < n; ++i) row[i] = round_value(row[i] / sum, result, config.mode);
+    }
+}
+
+bool softmax(const Tensor& x, Tensor& out, const SoftmaxConfig& config) {
+    if (x.size() != out.size()) return false;
+    Format result = out.get_format();
+    size_t cols = row_length(x);
+    for_each_row(x, out, cols, config.mode, [&](double* row, size_t) {
+        softmax_row(row, cols, config, result);
+    });
+    return true;
+}
+
+static bool norm_shapes(const Tensor& x, const Tensor& out, size_t cols, const Tensor& gamma) {
+    return x.size() == out.size() && cols != 0 && gamma.size() == cols;
+}
+
+bool layer_norm(const Tensor& x, const Tensor& gamma, const Tensor& beta, Tensor& out,
+                const NormConfig& config) {
+    size_t cols = row_length(x);
+    if (!norm_shapes(x, out, cols, gamma) || beta.size() != cols) return false;
+    std::vector<double> g(cols), b(cols);
+    gamma.decode_range(0, cols, g.data());
+    beta.decode_range(0, cols, b.data());
+    auto r = [&](double value, Format format) { return round_value(value, format, config.mode); };
+    auto acc = [&](double a, double b) { return round_sum(a, b, config.accumulator, config.mode); };
+
+    for_each_row(x, out, cols, config.mode, [&](double* row, size_t) {
+        double sum = 0.0;
+        for (size_t i = 0; i < cols; ++i) sum = acc(sum, row[i]);
+        double mean = r(sum / cols, config.statistics);
+        double squares = 0.0;
+        for (size_t i = 0; i < cols; ++i) {
+            row[i] = acc(row[i], -mean);
+            squares = acc(squares, row[i] * row[i]);
+        }
+        double variance = r(squares / cols, config.statistics);
+        double rstd = r(1.0 / std::sqrt(variance + config.epsilon), config.statistics);
+        for (size_t i = 0; i < cols; ++i) {
+            double scaled = r(r(row[i] * rstd, config.statistics) * g[i], config.affine);
+            row[i] = round_sum(scaled, b[i], config.affine, config.mode);
+        }
+    });
+    return true;
+}
+
+bool rms_norm(const Tensor& x, const Tensor& gamma, Tensor& out, const NormConfig& config) {
+    size_t cols = row_length(x);
+    if (!norm_shapes(x, out, cols, gamma)) return false;
+    std::vector<double> g(cols);
+    gamma.decode_range(0, cols, g.data());
+    auto r = [&](double value, Format format) { return round_value(value, format, config.mode); };
+
+    for_each_row(x, out, cols, config.mode, [&](double* row, size_t) {
+        double squares = 0.0;
+        for (size_t i = 0; i < cols; ++i)
+            squares = round_sum(squares, row[i] * row[i], config.accumulator, config.mode);
+        double mean_square = r(squares / cols, config.statistics);
+        double rstd = r(1.0 / std::sqrt(mean_square + config.epsilon), config.statistics);
+        for (size_t i = 0; i < cols; ++i) row[i] = r(r(row[i] * rstd, config.statistics) * g[i], config.affine);
+    });
+    return true;
+}
+
+bool activation(const Tensor& x, Tensor& out, Activation kind, const ActivationConfig& config) {
+    if (x.size() != out.size()) return false;
+    const double inv_sqrt2 = 1.0 / std::sqrt(2.0);
+    const double sqrt_2_over_pi = std::sqrt(2.0 / std::acos(-1.0));
+    auto r = [&](double value) { return round_value(value, config.intermediate, config.mode); };
+    auto e = [&](double value) { return round_value(value, config.epilogue, config.mode); };
+    auto one_plus = [&](double value) { return round_sum(1.0, value, config.epilogue, config.mode); };
+
+    parallel_for(0, x.size(), element_grain, [&](size_t first, size_t last) {
+        std::vector<double> buffer(last - first);
+        x.decode_range(first, last, buffer.data());
+        for (double& v : buffer) {
+            switch (kind) {
+            case Activation::gelu_erf:
+                v = e(e(0.5 * v) * one_plus(r(std::erf(r(v * inv_sqrt2)))));
+                break;
+            case Activation::gelu_tanh:
+                v = e(e(0.5 * v) * one_plus(r(std::tanh(r(sqrt_2_over_pi * (v + 0.044715 * v * v * v))))));
+                break;
+            case Activation::silu:
+                v = e(v * r(1.0 / (1.0 + std::exp(-v))));
+                break;
+            }
+        }
+        out.encode_range(first, last, buffer.data(), config.mode);
+    });
+    return true;
+}
+
+// {heads, rows, cols} of a 2-D or 3-D tensor
+static bool head_shape(const Tensor& t, size_t& heads, size_t& rows, size_t& cols) {
+    const auto& shape = t.get_shape();
+    if (shape.size() == 2) {
+        heads = 1;
+        rows = shape[0];
+        cols = shape[1];
+        return true;
+    }
+    if (shape.size() == 3) {
+        heads = shape[0];
+        rows = shape[1];
+        cols = shape[2];
+        return true;
+    }
+    return false;
+}
+
+bool attention(const Tensor& q, const Tensor& k, const Tensor& v, Tensor& out,
+               const AttentionConfig& config) {
+    size_t heads, seq_q, d, k_heads, seq_k, k_d, v_heads, v_rows, dv, o_heads, o_rows, o_cols;
+    if (!head_shape(q, heads, seq_q, d) || !head_shape(k, k_heads, seq_k, k_d) ||
+        !head_shape(v, v_heads, v_rows, dv) || !head_shape(out, o_heads, o_rows, o_cols))
+        return false;
+    if (k_heads != heads || v_heads != heads || o_heads != heads || k_d != d || v_rows != seq_k ||
+        o_rows != seq_q || o_cols != dv)
+        return false;
+
+    const RoundingMode mode = config.mode;
+    double scale = config.scale != 0.0 ? config.scale : 1.0 / std::sqrt(static_cast<double>(d));
+    scale = round_value(scale, config.score, mode);
+
+    // one task per (head, block of query rows); k and v of a head are decoded
+    // once per task, scores and weights live in a single row buffer
+    size_t row_grain = std::max<size_t>(1, element_grain / std::max<size_t>(seq_k * (d + dv), 1));
+    size_t row_blocks = (seq_q + row_grain - 1) / row_grain;
+    parallel_for(0, heads * row_blocks, 1, [&](size_t first, size_t last) {
+        std::vector<double> qv(d), kv(seq_k * d), vv(seq_k * dv), scores(seq_k), acc(dv);
+        size_t decoded_head = heads;
+        for (size_t task = first; task < last; ++task) {
+            size_t h = task / row_blocks;
+            size_t row_begin = (task % row_blocks) * row_grain;
+            size_t row_end = std::min(seq_q, row_begin + row_grain);
+            if (h != decoded_head) {
+                k.decode_range(h * seq_k * d, (h + 1) * seq_k * d, kv.data());
+                v.decode_range(h * seq_k * dv, (h + 1) * seq_k * dv, vv.data());
+                decoded_head = h;
+            }
+
+            for (size_t i = row_begin; i < row_end; ++i) {
+                q.decode_range((h * seq_q + i) * d, (h * seq_q + i + 1) * d, qv.data());
+                size_t visible = seq_k;
+                if (config.causal) {
+                    // keys are aligned to the end of the query sequence
+                    long long last_key = static_cast<long long>(i + seq_k) - static_cast<long long>(seq_q);
+                    visible = static_cast<size_t>(std::max(0LL, std::min<long long>(seq_k, last_key + 1)));
+                }
+                for (size_t j = 0; j < visible; ++j) {
+                    double dot = 0.0;
+                    const double* key = kv.data() + j * d;
+                    for (size_t c = 0; c < d; ++c)
+                        dot = round_sum(dot, qv[c] * key[c], config.score_accumulator, mode);
+                    scores[j] = round_value(dot * scale, config.score, mode);
+                }
+                softmax_row(scores.data(), visible, config.softmax, config.probability);
+
+                std::fill(acc.begin(), acc.end(), 0.0);
+                for (size_t j = 0; j < visible; ++j) {
+                    if (scores[j] == 0.0) continue;
+                    const double* value = vv.data() + j * dv;
+                    for (size_t c = 0; c < dv; ++c)
+                        acc[c] = round_sum(acc[c], scores[j] * value[c], config.output_accumulator, mode);
+                }
+                out.encode_range((h * seq_q + i) * dv, (h * seq_q + i + 1) * dv, acc.data(), mode);
+            }
+        }
+    });
+    return true;
+}
+
+}
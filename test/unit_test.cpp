@@ -1,5 +1,25 @@
 #include "gtest/gtest.h"
 #include "CustomFP.hpp"
+#include "Tensor.hpp"
+#include "ThreadPool.hpp"
+#include "Expression.hpp"
+#include "Ordering.hpp"
+#include "Sweep.hpp"
+#include "Instrumentation.hpp"
+#include "Trace.hpp"
+#include "Sparse.hpp"
+#include "FFT.hpp"
+#include "Solver.hpp"
+#include "Transformer.hpp"
+#include "Executor.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <atomic>
 #include <iostream>
 
 using namespace CustomFP;
@@ -9,6 +29,17 @@ using namespace CustomFP;
 // - Basic Operator Tests: alignment, format compare
 // - Arithmetic Tests: single precision + mixed precision computations
 // - Arithmetic Edge Case Tests: NaN, inf, multiply by zero, subnormal, divide by zero
+// - Format Conversion Tests: encode/decode, rounding modes, packed tensors
+// - Expression Tests: fused evaluation, rounding points, broadcast, thread pool
+// - Ordering Tests: total-order keys, comparisons, radix sort, top-k, quantile
+// - Sweep Tests: workload loading, work-stealing pool, format sweep
+// - Instrumentation Tests: event counters, per-thread aggregation, JSON export
+// - Trace Tests: recording through small rings, replay, first divergence
+// - Sparse Tests: CSR and 2:4 construction, SpMV/SpMM against dense MAC loops
+// - FFT Tests: complex multiply forms, radix-2/4 FFT against a DFT, batching, round trip
+// - Solver Tests: CG with Jacobi preconditioning, LU iterative refinement, residual history
+// - Transformer Tests: softmax, layer/RMS norm, GELU/SiLU and attention against unfused references
+// - Executor Tests: stateless operators, parallel_transform, grain autotuning, core pinning
 
 
 
@@ -317,3 +348,1354 @@ TEST(FPTest, Multiply_NaN_Test) {
 // ------------------------------------------------------------
 
 
+// ------------------------------------------------------------
+// 8. Format Conversion Tests
+// ------------------------------------------------------------
+
+TEST(FPTest, Encode_Decode_FP16_Test) {
+    Format fp16{5, 10};
+    EXPECT_EQ(encode(1.0, fp16), 0x3C00);
+    EXPECT_EQ(encode(12.5, fp16), 0x4A40);
+    EXPECT_EQ(encode(-2.0, fp16), 0xC000);
+    EXPECT_DOUBLE_EQ(decode(0x4A40, fp16), 12.5);
+    EXPECT_DOUBLE_EQ(decode(0x0001, fp16), std::ldexp(1.0, -24));  // smallest subnormal
+    EXPECT_EQ(encode(std::ldexp(1.0, -24), fp16), 0x0001);
+    EXPECT_TRUE(std::isnan(decode(0x7E01, fp16)));
+    EXPECT_TRUE(std::isinf(decode(0xFC00, fp16)));
+}
+
+TEST(FPTest, Encode_Rounding_Test) {
+    Format fp16{5, 10};
+    double halfway = 1.0 + std::ldexp(1.0, -11);  // between 0x3C00 and 0x3C01
+    EXPECT_EQ(encode(halfway, fp16), 0x3C00);      // ties to even
+    EXPECT_EQ(encode(halfway, fp16, RoundingMode::toward_pos_inf), 0x3C01);
+    EXPECT_EQ(encode(-halfway, fp16, RoundingMode::toward_neg_inf), 0xBC01);
+    EXPECT_EQ(encode(-halfway, fp16, RoundingMode::toward_zero), 0xBC00);
+
+    // overflow saturates only under directed rounding toward zero
+    EXPECT_EQ(encode(1e6, fp16), 0x7C00);
+    EXPECT_EQ(encode(1e6, fp16, RoundingMode::toward_zero), 0x7BFF);
+    EXPECT_EQ(encode(65520.0, fp16), 0x7C00);      // rounds up past max finite
+    EXPECT_EQ(encode(65504.0, fp16), 0x7BFF);
+}
+
+TEST(FPTest, Tensor_Pack_Test) {
+    Tensor fp8(Format{4, 3}, {2, 3});
+    EXPECT_EQ(fp8.get_element_bytes(), 1);
+    EXPECT_EQ(fp8.size(), 6);
+    fp8.set(4, 1.5);
+    EXPECT_DOUBLE_EQ(fp8.get(4), 1.5);
+    EXPECT_EQ(fp8.get_exmy(4).get_flag(), ExMy::FP_status::normal);
+
+    Tensor fp32(Format{8, 23}, 3);
+    EXPECT_EQ(fp32.get_element_bytes(), 4);
+    fp32.set(0, 0.1);
+    EXPECT_EQ(fp32.get_bits(0), 0x3DCCCCCD);
+}
+
+TEST(FPTest, DecodeTable_Concurrent_Test) {
+    // first lookups race from several threads; all must see one complete table
+    Format fp16{5, 10};
+    std::vector<const double*> seen(8, nullptr);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < seen.size(); ++t)
+        threads.emplace_back([&, t] { seen[t] = decode_table(fp16); });
+    for (auto& thread : threads) thread.join();
+    for (const double* table : seen) EXPECT_EQ(table, seen[0]);
+    ASSERT_NE(seen[0], nullptr);
+    for (unsigned long long raw = 0; raw < (1ULL << 16); raw += 251)
+        if (!std::isnan(seen[0][raw])) {
+            EXPECT_DOUBLE_EQ(seen[0][raw], decode(raw, fp16));
+        }
+    EXPECT_EQ(decode_table(Format{8, 23}), nullptr);
+}
+
+
+// ------------------------------------------------------------
+// 9. Expression Tests
+// ------------------------------------------------------------
+
+TEST(FPTest, Expression_Fused_MulAdd_Test) {
+    Format fp16{5, 10};
+    const size_t n = 5000;
+    Tensor a(fp16, n), b(fp16, n), c(fp16, n), y(fp16, n);
+    for (size_t i = 0; i < n; ++i) {
+        a.set(i, 1.0 + i * 0.001);
+        b.set(i, 3.0 - i * 0.0005);
+        c.set(i, -0.25 * (i % 7));
+    }
+
+    auto expr = a * b + c;
+    ASSERT_TRUE(expr.eval(y));
+    for (size_t i = 0; i < n; ++i)
+        EXPECT_EQ(y.get_bits(i), encode(a.get(i) * b.get(i) + c.get(i), fp16));
+}
+
+TEST(FPTest, Expression_RoundingPoint_Test) {
+    Format fp16{5, 10};
+    Format fp8{4, 3};
+    Tensor a(fp16, 1), b(fp16, 1), y(fp16, 1);
+    a.set(0, 1.0 + std::ldexp(1.0, -10));
+    b.set(0, 1.0);
+
+    // no intermediate rounding: product kept exact
+    ASSERT_TRUE((a * b).eval(y));
+    EXPECT_EQ(y.get_bits(0), 0x3C01);
+
+    // rounding the product to E4M3 drops the low mantissa bit
+    ASSERT_TRUE(round(a * b, fp8).eval(y));
+    EXPECT_EQ(y.get_bits(0), 0x3C00);
+}
+
+TEST(FPTest, Expression_SingleRounding_Test) {
+    Format fp16{5, 10}, fp32{8, 23};
+    Tensor a(fp32, 2), b(fp32, 2), c(fp32, 2), y(fp16, 2);
+    // 1 + 2^-11 is a fp16 tie; the tiny addend decides it, though it is lost
+    // when the sum is first rounded to a double
+    a.set(0, 1.0 + std::ldexp(1.0, -11));
+    b.set(0, 1.0);
+    c.set(0, std::ldexp(1.0, -70));
+    a.set(1, 1.0);
+    b.set(1, 1.0);
+    c.set(1, -std::ldexp(1.0, -70));
+
+    ASSERT_TRUE((a * b + c).eval(y));
+    EXPECT_EQ(y.get_bits(0), 0x3C01);
+    EXPECT_EQ(y.get_bits(1), 0x3C00);
+    ASSERT_TRUE((a * b + c).eval(y, RoundingMode::toward_zero));
+    EXPECT_EQ(y.get_bits(1), 0x3BFF);
+
+    // the error term survives cancellation of the leading parts
+    Tensor wide(fp32, 2);
+    ASSERT_TRUE((c + a * b - a * b).eval(wide));
+    EXPECT_EQ(wide.get(0), std::ldexp(1.0, -70));
+
+    // a round() node in between restores per-operation rounding
+    ASSERT_TRUE((round(a * b, fp16) + c).eval(y));
+    EXPECT_EQ(y.get_bits(0), 0x3C00);
+}
+
+TEST(FPTest, Expression_Broadcast_Epilogue_Test) {
+    Format fp16{5, 10};
+    Tensor x(fp16, {4, 3}), bias(fp16, 3), y(fp16, {4, 3});
+    for (size_t i = 0; i < x.size(); ++i) x.set(i, static_cast<double>(i) - 6.0);
+    bias.set(0, 1.0);
+    bias.set(1, 2.0);
+    bias.set(2, 3.0);
+
+    ASSERT_TRUE(relu(x * 0.5 + bias).eval(y));
+    for (size_t i = 0; i < y.size(); ++i) {
+        double expected = std::max(0.0, (static_cast<double>(i) - 6.0) * 0.5 + bias.get(i % 3));
+        EXPECT_DOUBLE_EQ(y.get(i), expected);
+    }
+
+    Tensor wrong(fp16, 5);
+    EXPECT_FALSE((x + wrong).eval(y));
+}
+
+TEST(FPTest, ThreadPool_ParallelFor_Test) {
+    ThreadPool pool(4);
+    EXPECT_EQ(pool.get_num_threads(), 4u);
+    std::vector<std::atomic<int>> hits(10007);
+    pool.parallel_for(0, hits.size(), 7, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) hits[i]++;
+    });
+    for (auto& h : hits) EXPECT_EQ(h.load(), 1);
+}
+
+
+// ------------------------------------------------------------
+// 10. Ordering Tests
+// ------------------------------------------------------------
+
+TEST(FPTest, OrderKey_TotalOrder_Test) {
+    Format fp16{5, 10};
+    // -NaN < -inf < -1 < -0 < +0 < subnormal < 1 < +inf < +NaN
+    std::vector<unsigned long long> ordered = {0xFE01, 0xFC00, 0xBC00, 0x8000, 0x0000,
+                                               0x0001, 0x3C00, 0x7C00, 0x7E01};
+    for (size_t i = 0; i + 1 < ordered.size(); ++i) {
+        EXPECT_LT(to_order_key(ordered[i], fp16), to_order_key(ordered[i + 1], fp16));
+        EXPECT_TRUE(total_order(ordered[i], ordered[i + 1], fp16));
+    }
+    for (auto raw : ordered) EXPECT_EQ(from_order_key(to_order_key(raw, fp16), fp16), raw);
+}
+
+TEST(FPTest, ExMy_Compare_Test) {
+    ExMy one(1, 5, 10), two(1, 5, 10), pos_zero(1, 5, 10), neg_zero(1, 5, 10), nan(1, 5, 10);
+    one.set_bits(0x3C00);
+    two.set_bits(0x4000);
+    pos_zero.set_bits(0x0000);
+    neg_zero.set_bits(0x8000);
+    nan.set_bits(0x7E01);
+
+    EXPECT_TRUE(one < two);
+    EXPECT_TRUE(two >= one);
+    EXPECT_TRUE(pos_zero == neg_zero);
+    EXPECT_FALSE(neg_zero < pos_zero);
+    EXPECT_FALSE(nan == nan);
+    EXPECT_FALSE(nan < one);
+    EXPECT_FALSE(one < nan);
+
+    EXPECT_EQ(min(neg_zero, pos_zero).get_raw_bits(), 0x8000);
+    EXPECT_EQ(max(neg_zero, pos_zero).get_raw_bits(), 0x0000);
+    EXPECT_EQ(max(one, nan).get_flag(), ExMy::FP_status::NaN);
+    EXPECT_EQ(neg(one).get_raw_bits(), 0xBC00);
+    EXPECT_EQ(abs(neg(two)).get_raw_bits(), 0x4000);
+
+    // mixed formats compare by value
+    ExMy one_fp8(1, 4, 3);
+    one_fp8.set_bits(encode(1.0, Format{4, 3}));
+    EXPECT_TRUE(one == one_fp8);
+
+    // min / max need one format, as the arithmetic operators do
+    ExMy half_fp8(1, 4, 3);
+    half_fp8.set_bits(encode(0.5, Format{4, 3}));
+    EXPECT_EQ(min(one, half_fp8).get_flag(), ExMy::FP_status::NaN);
+    EXPECT_EQ(max(one, half_fp8).get_flag(), ExMy::FP_status::NaN);
+    EXPECT_EQ(min(one, half_fp8).get_format(), one.get_format());
+}
+
+TEST(FPTest, Batch_OrderKeys_Test) {
+    Format fp8{4, 3}, fp16{5, 10};
+    Tensor narrow(fp8, 5), wide(fp16, 5);
+    double values[] = {-1.0, 0.0, 2.0, -0.0, NAN};
+    for (size_t i = 0; i < 5; ++i) {
+        narrow.set(i, values[i]);
+        wide.set(i, values[i]);
+    }
+
+    // keys match the storage width and the scalar keys
+    std::vector<uint8_t> keys8;
+    std::vector<uint16_t> keys16;
+    std::vector<unsigned long long> keys64;
+    ASSERT_TRUE(batch_order_keys(narrow, keys8));
+    ASSERT_TRUE(batch_order_keys(wide, keys16));
+    ASSERT_TRUE(batch_order_keys(wide, keys64));
+    for (size_t i = 0; i < 5; ++i) {
+        EXPECT_EQ(keys8[i], to_order_key(narrow.get_bits(i), fp8));
+        EXPECT_EQ(keys16[i], to_order_key(wide.get_bits(i), fp16));
+        EXPECT_EQ(keys64[i], keys16[i]);
+    }
+    EXPECT_FALSE(batch_order_keys(wide, keys8));
+}
+
+TEST(FPTest, Batch_MinMax_Test) {
+    Format fp8{4, 3};
+    Tensor a(fp8, 4), b(fp8, 4), out(fp8, 4);
+    double av[] = {1.0, -2.0, 0.0, NAN};
+    double bv[] = {0.5, 3.0, -0.0, 1.0};
+    for (size_t i = 0; i < 4; ++i) {
+        a.set(i, av[i]);
+        b.set(i, bv[i]);
+    }
+    ASSERT_TRUE(batch_min(a, b, out));
+    EXPECT_DOUBLE_EQ(out.get(0), 0.5);
+    EXPECT_DOUBLE_EQ(out.get(1), -2.0);
+    EXPECT_TRUE(std::signbit(out.get(2)));
+    EXPECT_TRUE(std::isnan(out.get(3)));
+
+    std::vector<uint8_t> less;
+    ASSERT_TRUE(batch_less(a, b, less));
+    EXPECT_EQ(less, (std::vector<uint8_t>{0, 1, 0, 0}));
+
+    ASSERT_TRUE(batch_neg(a, out));
+    EXPECT_DOUBLE_EQ(out.get(1), 2.0);
+    ASSERT_TRUE(batch_abs(out, out));
+    EXPECT_DOUBLE_EQ(out.get(0), 1.0);
+}
+
+TEST(FPTest, RadixSort_Test) {
+    Format fp16{5, 10};
+    const size_t n = 300000;
+    Tensor t(fp16, n);
+    std::mt19937 rng(7);
+    std::normal_distribution<double> dist(0.0, 100.0);
+    for (size_t i = 0; i < n; ++i) t.set(i, dist(rng));
+    t.set(5, INFINITY);
+    t.set(6, -INFINITY);
+
+    std::vector<unsigned long long> expected(n);
+    for (size_t i = 0; i < n; ++i) expected[i] = t.get_bits(i);
+    std::sort(expected.begin(), expected.end(), [&](auto x, auto y) {
+        return to_order_key(x, fp16) < to_order_key(y, fp16);
+    });
+
+    radix_sort(t);
+    for (size_t i = 0; i < n; ++i) ASSERT_EQ(t.get_bits(i), expected[i]);
+    EXPECT_TRUE(std::isinf(t.get(0)));
+    EXPECT_TRUE(std::isinf(t.get(n - 1)));
+}
+
+TEST(FPTest, TopK_Quantile_Test) {
+    Format fp8{4, 3};
+    const size_t n = 200000;
+    Tensor t(fp8, n);
+    for (size_t i = 0; i < n; ++i) t.set(i, static_cast<double>(i % 97) / 8.0 - 4.0);
+    t.set(123, 100.0);
+    t.set(456, 96.0);
+
+    auto top = top_k(t, 3);
+    ASSERT_EQ(top.size(), 3u);
+    EXPECT_EQ(top[0], 123u);
+    EXPECT_EQ(top[1], 456u);
+    // largest repeated value at its lowest index: 7.75 and 7.875 round to 8 in E4M3
+    size_t tie = 0;
+    for (size_t i = 1; i < n; ++i)
+        if (i != 123 && i != 456 && (tie == 123 || tie == 456 || t.get(i) > t.get(tie))) tie = i;
+    EXPECT_EQ(tie, 94u);
+    EXPECT_EQ(top[2], tie);
+
+    auto bottom = top_k(t, 2, false);
+    EXPECT_EQ(bottom[0], 0u);
+    EXPECT_EQ(bottom[1], 1u);      // -3.875 ties to -4 in E4M3
+
+    Tensor sorted = t;
+    radix_sort(sorted);
+    EXPECT_EQ(select_rank(t, 0), sorted.get_bits(0));
+    EXPECT_EQ(select_rank(t, n / 3), sorted.get_bits(n / 3));
+    EXPECT_DOUBLE_EQ(quantile(t, 0.5), sorted.get((n - 1) / 2));
+    EXPECT_DOUBLE_EQ(quantile(t, 1.0), 96.0);   // 100 rounds to 96 in E4M3
+}
+
+
+// ------------------------------------------------------------
+// 11. Sweep Tests
+// ------------------------------------------------------------
+
+TEST(FPTest, ThreadPool_NestedTasks_Test) {
+    ThreadPool pool(3);
+    std::atomic<int> total{0};
+    TaskGroup outer;
+    for (int i = 0; i < 8; ++i) {
+        pool.submit(outer, [&] {
+            pool.parallel_for(0, 1000, 10, [&](size_t begin, size_t end) {
+                total += static_cast<int>(end - begin);
+            });
+        });
+    }
+    pool.wait(outer);
+    EXPECT_EQ(total.load(), 8000);
+}
+
+TEST(FPTest, ThreadPool_WaitSleeps_Test) {
+    ThreadPool pool(2);
+    TaskGroup group;
+    std::atomic<bool> started{false};
+    pool.submit(group, [&] {
+        started = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    });
+    while (!started) std::this_thread::yield();
+    // the task is running elsewhere and nothing is left to steal; the waiter
+    // must block instead of spinning for the whole 300 ms
+    std::clock_t before = std::clock();
+    pool.wait(group);
+    double cpu_seconds = static_cast<double>(std::clock() - before) / CLOCKS_PER_SEC;
+    EXPECT_TRUE(group.done());
+    EXPECT_LT(cpu_seconds, 0.1);
+}
+
+TEST(FPTest, Workload_Load_Test) {
+    std::istringstream text(
+        "# two ops\n"
+        "dot 3  1 2 3  4 5 6\n"
+        "gemm 1 2 2  1 2  3 4 5 6\n"
+        "reduce 2 0.5 0.25\n");
+    Workload workload;
+    ASSERT_TRUE(load_workload(text, workload));
+    ASSERT_EQ(workload.ops.size(), 3u);
+    EXPECT_EQ(workload.ops[1].kind, WorkloadOp::Kind::gemm);
+    EXPECT_EQ(workload.ops[1].b.size(), 4u);
+
+    std::istringstream truncated("dot 3 1 2 3 4");
+    EXPECT_FALSE(load_workload(truncated, workload));
+
+    Format format{};
+    EXPECT_TRUE(parse_format("e5m10", format));
+    EXPECT_EQ(format, (Format{5, 10}));
+    EXPECT_FALSE(parse_format("fp16", format));
+}
+
+TEST(FPTest, Sweep_ErrorVsCost_Test) {
+    Workload workload;
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    WorkloadOp gemm{WorkloadOp::Kind::gemm, 20, 12, 64, {}, {}};
+    for (size_t i = 0; i < gemm.m * gemm.k; ++i) gemm.a.push_back(dist(rng));
+    for (size_t i = 0; i < gemm.k * gemm.n; ++i) gemm.b.push_back(dist(rng));
+    workload.ops.push_back(gemm);
+    WorkloadOp reduce{WorkloadOp::Kind::reduce, 1, 500, 1, {}, {}};
+    for (size_t i = 0; i < reduce.n; ++i) reduce.a.push_back(dist(rng));
+    workload.ops.push_back(reduce);
+
+    auto grid = make_grid({{4, 3}, {5, 10}, {8, 23}}, {{5, 10}, {8, 23}},
+                          {RoundingMode::nearest_even, RoundingMode::toward_zero});
+    ASSERT_EQ(grid.size(), 12u);
+
+    ThreadPool pool(4);
+    auto results = run_sweep(workload, grid, pool);
+    ASSERT_EQ(results.size(), grid.size());
+    for (const auto& r : results) EXPECT_EQ(r.outputs, 20u * 12u + 1u);
+
+    // grid order: input-major, then accumulator, then rounding
+    const auto& fp8_fp32 = results[2];
+    const auto& fp16_fp32 = results[6];
+    const auto& fp32_fp32 = results[10];
+    EXPECT_GT(fp8_fp32.mean_rel_error, fp16_fp32.mean_rel_error);
+    EXPECT_GT(fp16_fp32.mean_rel_error, fp32_fp32.mean_rel_error);
+    EXPECT_LT(fp32_fp32.max_rel_error, 1e-4);
+    EXPECT_LT(fp8_fp32.area, fp32_fp32.area);
+    EXPECT_DOUBLE_EQ(fp32_fp32.area, 1.0);
+    EXPECT_EQ(fp8_fp32.bits, 8u);
+
+    std::ostringstream table;
+    write_table(table, results);
+    EXPECT_NE(table.str().find("e4m3,e8m23,rne,8,"), std::string::npos);
+}
+
+TEST(FPTest, Sweep_DirectedRounding_Test) {
+    // 65536 + 2^-48 is not a double; the directed modes must still see the tail
+    Format fp32{8, 23};
+    double tail = std::ldexp(1.0, -48);
+    EXPECT_DOUBLE_EQ(round_sum(65536.0, tail, fp32, RoundingMode::toward_pos_inf), 65536.0 + std::ldexp(1.0, -7));
+    EXPECT_DOUBLE_EQ(round_sum(65536.0, tail, fp32, RoundingMode::toward_neg_inf), 65536.0);
+    EXPECT_DOUBLE_EQ(round_sum(65536.0, -tail, fp32, RoundingMode::toward_zero), 65536.0 - std::ldexp(1.0, -8));
+    EXPECT_DOUBLE_EQ(round_sum(65536.0, -tail, fp32, RoundingMode::nearest_even), 65536.0);
+    // a double sum exactly halfway between two fp32 values: the tail breaks the tie
+    double half = 1.0 + std::ldexp(1.0, -24);
+    EXPECT_DOUBLE_EQ(round_sum(half, std::ldexp(1.0, -80), fp32), 1.0 + std::ldexp(1.0, -23));
+    EXPECT_DOUBLE_EQ(round_sum(half, -std::ldexp(1.0, -80), fp32), 1.0);
+
+    Workload workload;
+    WorkloadOp reduce{WorkloadOp::Kind::reduce, 1, 2, 1, {65536.0, tail}, {}};
+    workload.ops.push_back(reduce);
+    ThreadPool pool(2);
+    auto results = run_sweep(workload, make_grid({fp32}, {fp32}, {RoundingMode::toward_pos_inf}), pool);
+    ASSERT_EQ(results.size(), 1u);
+    EXPECT_GT(results[0].max_abs_error, 0.0);
+    EXPECT_NEAR(results[0].max_abs_error, std::ldexp(1.0, -7), 1e-12);
+
+    // an m52 product is not a double: (1 + 2^-52)^2 = 1 + 2^-51 + 2^-104,
+    // so rup lands one ulp above 1 + 2^-51 and rdn on it
+    Format fp64{11, 52};
+    double wide = 1.0 + std::ldexp(1.0, -52);
+    Workload dot;
+    dot.ops.push_back(WorkloadOp{WorkloadOp::Kind::dot, 1, 1, 1, {wide}, {wide}});
+    auto up = run_sweep(dot, make_grid({fp64}, {fp64}, {RoundingMode::toward_pos_inf}), pool);
+    auto down = run_sweep(dot, make_grid({fp64}, {fp64}, {RoundingMode::toward_neg_inf}), pool);
+    ASSERT_EQ(up.size(), 1u);
+    ASSERT_EQ(down.size(), 1u);
+    EXPECT_DOUBLE_EQ(up[0].max_abs_error, std::ldexp(1.0, -52));
+    EXPECT_DOUBLE_EQ(down[0].max_abs_error, 0.0);
+}
+
+
+// ------------------------------------------------------------
+// 12. Instrumentation Tests
+// ------------------------------------------------------------
+
+#if FLEXFLOAT_INSTRUMENT
+
+// counters of one (op, format) pair, zero if never hit
+static EventCounts counts_for(OpKind op, Format format) {
+    for (const auto& entry : event_snapshot())
+        if (entry.op == op && entry.format == format) return entry;
+    return EventCounts{op, format, {}};
+}
+
+TEST(FPTest, Instrument_Convert_Events_Test) {
+    reset_event_counters();
+    Format e6m9{6, 9};
+    encode(1e30, e6m9);
+    encode(1e-30, e6m9);
+    encode(std::ldexp(1.0, -35), e6m9);
+    encode(NAN, e6m9);
+    encode(1.0, e6m9);
+
+    auto counts = counts_for(OpKind::convert, e6m9);
+    EXPECT_EQ(counts.counts[static_cast<size_t>(Event::overflow)], 1u);
+    EXPECT_EQ(counts.counts[static_cast<size_t>(Event::flush_to_zero)], 1u);
+    EXPECT_EQ(counts.counts[static_cast<size_t>(Event::subnormal)], 1u);
+    EXPECT_EQ(counts.counts[static_cast<size_t>(Event::nan_propagation)], 1u);
+}
+
+TEST(FPTest, Instrument_Operator_Events_Test) {
+    reset_event_counters();
+    ExMy a(1, 5, 10), target(1, 5, 10);
+    a.exponent = 20;
+    a.mantissa = 0b1011;
+    target.exponent = 18;
+    Operator op;
+    op.align(&a, &target);
+    EXPECT_EQ(counts_for(OpKind::align, Format{5, 10}).counts[static_cast<size_t>(Event::alignment_loss)], 1u);
+
+    ExMy nan(1, 5, 10), one(1, 5, 10), result(1, 5, 10);
+    nan.set_bits(0x7E01);
+    one.set_bits(0x3C00);
+    Adder adder;
+    adder.add(&nan, &one, &result);
+    EXPECT_EQ(counts_for(OpKind::add, Format{5, 10}).counts[static_cast<size_t>(Event::nan_propagation)], 1u);
+}
+
+TEST(FPTest, Instrument_Multiply_Overflow_Test) {
+    reset_event_counters();
+    const size_t overflow = static_cast<size_t>(Event::overflow);
+    ExMy inf(1, 5, 10), two(1, 5, 10), large(1, 5, 10), result(1, 5, 10);
+    inf.set_bits(0x7C00);
+    two.set_bits(0x4000);
+    large.set_bits(0x7800);   // 32768
+    Multiplier mul;
+    mul.mul(&inf, &two, &result);
+    EXPECT_EQ(counts_for(OpKind::multiply, Format{5, 10}).counts[overflow], 0u);   // inf operand is not an overflow
+
+    mul.mul(&large, &two, &result);
+    EXPECT_EQ(counts_for(OpKind::multiply, Format{5, 10}).counts[overflow], 1u);   // counted once
+}
+
+TEST(FPTest, Instrument_ThreadAggregation_Test) {
+    reset_event_counters();
+    Format e7m4{7, 4};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 1000; ++i) count_event(OpKind::add, e7m4, Event::cancellation);
+        });
+    }
+    for (auto& t : threads) t.join();
+    EXPECT_EQ(counts_for(OpKind::add, e7m4).counts[static_cast<size_t>(Event::cancellation)], 4000u);
+
+    std::string json = event_json();
+    EXPECT_NE(json.find("\"op\": \"add\", \"format\": \"e7m4\""), std::string::npos);
+    EXPECT_NE(json.find("\"cancellation\": 4000"), std::string::npos);
+}
+
+TEST(FPTest, Instrument_Other_Formats_Test) {
+    reset_event_counters();
+    // more formats than a thread tracks; the excess goes to the "other"
+    // bucket rather than to whichever format holds the last slot
+    const unsigned formats = 40;
+    std::thread([&] {
+        for (unsigned m = 0; m < formats; ++m) count_event(OpKind::divide, Format{3, 100 + m}, Event::subnormal);
+    }).join();
+
+    const size_t subnormal = static_cast<size_t>(Event::subnormal);
+    unsigned long long named = 0;
+    for (unsigned m = 0; m < formats; ++m) {
+        unsigned long long c = counts_for(OpKind::divide, Format{3, 100 + m}).counts[subnormal];
+        EXPECT_LE(c, 1u);
+        named += c;
+    }
+    unsigned long long other = counts_for(OpKind::divide, Format{0, 0}).counts[subnormal];
+    EXPECT_GE(other, formats - 32);
+    EXPECT_EQ(named + other, formats);
+    EXPECT_NE(event_json().find("\"op\": \"divide\", \"format\": \"other\""), std::string::npos);
+}
+
+#endif
+
+
+// ------------------------------------------------------------
+// 13. Trace Tests
+// ------------------------------------------------------------
+
+#if FLEXFLOAT_TRACE
+
+TEST(FPTest, Trace_Record_Replay_Test) {
+    std::string path = testing::TempDir() + "flexfloat_trace.bin";
+    // tiny rings force wraparound and producer back-pressure
+    ASSERT_TRUE(trace_start(path, 8));
+
+    const int per_thread = 2000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 3; ++t) {
+        threads.emplace_back([t] {
+            ExMy a(1, 5, 10), b(1, 5, 10), result(1, 5, 10);
+            Adder adder;
+            Multiplier multiplier;
+            for (int i = 0; i < per_thread; ++i) {
+                a.set_bits(0x3C00 + ((i * 7 + t) & 0x3FF));
+                b.set_bits(0x4000 + (i & 0x1FF));
+                // results are reused; inf + x takes its sign from the inf operand
+                if (i % 10 == 3) {
+                    a.set_bits(0x7C00);
+                    result.set_bits(0xBC00);
+                }
+                if (i % 2) adder.add(&a, &b, &result);
+                else multiplier.mul(&a, &b, &result);
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    trace_stop();
+
+    std::vector<TraceRecord> records;
+    ASSERT_TRUE(read_trace(path, records));
+    ASSERT_EQ(records.size(), 3u * per_thread);
+    EXPECT_EQ(records[0].result_mantissa_bits, 10);
+    size_t inf_adds = 0;
+    for (const auto& record : records) {
+        if (record.op != static_cast<uint8_t>(OpKind::add) || record.a != 0x7C00u) continue;
+        ++inf_adds;
+        EXPECT_EQ(record.result, 0x7C00u);
+    }
+    EXPECT_EQ(inf_adds, 3u * per_thread / 10);
+
+    // the same operators reproduce every result
+    Divergence divergence;
+    ASSERT_TRUE(replay_trace(path, operator_backend(), divergence));
+    EXPECT_FALSE(divergence.found);
+
+    // a correctly rounded backend reports the first differing record
+    auto reference = reference_backend();
+    size_t expected = records.size();
+    for (size_t i = 0; i < records.size() && expected == records.size(); ++i) {
+        unsigned long long bits = reference(records[i]);
+        if (bits != records[i].result) expected = i;
+    }
+    ASSERT_TRUE(replay_trace(path, reference, divergence));
+    EXPECT_EQ(divergence.found, expected < records.size());
+    if (divergence.found) {
+        EXPECT_EQ(divergence.index, expected);
+        EXPECT_EQ(divergence.replayed, reference(divergence.record));
+    }
+}
+
+TEST(FPTest, Trace_Reference_Rounding_Test) {
+    // e11m52 operands whose exact results are not doubles: the reference
+    // must round the exact value, not the double result
+    Format fp64{11, 52};
+    auto record = [&](OpKind op, double a, double b) {
+        TraceRecord r{};
+        r.op = static_cast<uint8_t>(op);
+        r.a_exponent_bits = r.b_exponent_bits = r.result_exponent_bits = 11;
+        r.a_mantissa_bits = r.b_mantissa_bits = r.result_mantissa_bits = 52;
+        r.a = encode(a, fp64);
+        r.b = encode(b, fp64);
+        return r;
+    };
+    auto up = reference_backend(RoundingMode::toward_pos_inf);
+    auto down = reference_backend(RoundingMode::toward_neg_inf);
+    double ulp = std::ldexp(1.0, -52);
+    EXPECT_EQ(up(record(OpKind::add, 1.0, std::ldexp(1.0, -60))), encode(1.0 + ulp, fp64));
+    EXPECT_EQ(down(record(OpKind::subtract, 1.0, std::ldexp(1.0, -60))), encode(1.0 - ulp / 2, fp64));
+    EXPECT_EQ(up(record(OpKind::multiply, 1.0 + ulp, 1.0 + ulp)), encode(1.0 + 3 * ulp, fp64));
+    EXPECT_EQ(down(record(OpKind::multiply, 1.0 + ulp, 1.0 + ulp)), encode(1.0 + 2 * ulp, fp64));
+    EXPECT_EQ(up(record(OpKind::divide, 1.0, 3.0)) - down(record(OpKind::divide, 1.0, 3.0)), 1u);
+    EXPECT_TRUE(std::isinf(decode(up(record(OpKind::divide, 1.0, 0.0)), fp64)));
+}
+
+TEST(FPTest, Trace_Disabled_Test) {
+    EXPECT_FALSE(trace_enabled());
+    std::vector<TraceRecord> records;
+    EXPECT_FALSE(read_trace(testing::TempDir() + "missing_trace.bin", records));
+}
+
+#endif
+
+
+// ------------------------------------------------------------
+// 14. Sparse Tests
+// ------------------------------------------------------------
+
+// dense row-by-vector MAC loop with the kernels' rounding semantics
+static double dense_mac(const Tensor& a, size_t row, const std::vector<double>& x, const AccumulatorConfig& config) {
+    size_t cols = a.get_shape()[1];
+    double acc = 0.0;
+    for (size_t j = 0; j < cols; ++j) {
+        double v = a.get(row * cols + j);
+        if (v != 0.0) acc = round_sum(acc, v * x[j], config.accumulator, config.mode);
+    }
+    return acc;
+}
+
+TEST(FPTest, Csr_Construct_Test) {
+    Format fp8{4, 3};
+    CsrMatrix a(fp8, 3, 4, {{2, 1, 1.0}, {0, 3, 2.0}, {0, 0, -1.5}, {2, 1, 0.5}, {7, 0, 9.0}});
+    EXPECT_EQ(a.get_nnz(), 3u);                 // duplicate merged, out of range dropped
+    EXPECT_EQ(a.get_index_bytes(), 2u);
+    EXPECT_EQ(a.get_row_ptr(), (std::vector<size_t>{0, 2, 2, 3}));
+    EXPECT_EQ(a.get_col(0), 0u);
+    EXPECT_EQ(a.get_col(1), 3u);
+    EXPECT_DOUBLE_EQ(a.get_values().get(2), 1.5);
+
+    CsrMatrix wide(fp8, 1, 100000, {{0, 99999, 1.0}});
+    EXPECT_EQ(wide.get_index_bytes(), 4u);
+    EXPECT_EQ(wide.get_col(0), 99999u);
+}
+
+TEST(FPTest, Csr_Spmv_Spmm_Test) {
+    Format fp8{4, 3};
+    Format fp16{5, 10};
+    const size_t rows = 300, cols = 200, n = 3;
+    Tensor dense(fp8, {rows, cols});
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<double> dist(-2.0, 2.0);
+    std::uniform_int_distribution<int> keep(0, 9);
+    for (size_t i = 0; i < dense.size(); ++i)
+        if (keep(rng) < 2) dense.set(i, dist(rng));   // ~80% sparse
+
+    CsrMatrix a = CsrMatrix::from_dense(dense);
+    Tensor x(fp8, cols), y(fp16, rows);
+    std::vector<double> xv(cols);
+    for (size_t j = 0; j < cols; ++j) {
+        x.set(j, dist(rng));
+        xv[j] = x.get(j);
+    }
+
+    AccumulatorConfig config{fp16};
+    ASSERT_TRUE(spmv(a, x, y, config));
+    for (size_t r = 0; r < rows; ++r)
+        EXPECT_EQ(y.get_bits(r), encode(dense_mac(dense, r, xv, config), fp16));
+
+    Tensor b(fp8, {cols, n}), c(fp16, {rows, n});
+    for (size_t i = 0; i < b.size(); ++i) b.set(i, dist(rng));
+    ASSERT_TRUE(spmm(a, b, c, config));
+    for (size_t j = 0; j < n; ++j) {
+        std::vector<double> column(cols);
+        for (size_t k = 0; k < cols; ++k) column[k] = b.get(k * n + j);
+        for (size_t r = 0; r < rows; r += 37)
+            EXPECT_EQ(c.get_bits(r * n + j), encode(dense_mac(dense, r, column, config), fp16));
+    }
+
+    Tensor wrong(fp8, cols + 1);
+    EXPECT_FALSE(spmv(a, wrong, y, config));
+}
+
+TEST(FPTest, Structured_2_4_Test) {
+    Format fp16{5, 10};
+    Tensor dense(fp16, {2, 10});
+    double row0[] = {0.5, -3.0, 1.0, 2.0,   0.0, 0.0, 0.0, 7.0,   4.0, -5.0};
+    double row1[] = {1.0, 1.0, 1.0, 1.0,    9.0, 0.0, -8.0, 0.0,  0.0, 0.0};
+    for (size_t j = 0; j < 10; ++j) {
+        dense.set(j, row0[j]);
+        dense.set(10 + j, row1[j]);
+    }
+
+    StructuredSparseMatrix a(dense, 2, 4);
+    EXPECT_EQ(a.get_groups(), 3u);
+    EXPECT_EQ(a.get_values().size(), 12u);
+    EXPECT_EQ(a.get_metadata_bytes(), 4u);   // 12 positions x 2 bits + guard byte
+
+    std::vector<size_t> cols;
+    for (size_t k = 0; k < 12; ++k) cols.push_back(a.get_col(k));
+    EXPECT_EQ(cols, (std::vector<size_t>{1, 3, 4, 7, 8, 9,   0, 1, 4, 6, 8, 9}));
+    EXPECT_DOUBLE_EQ(a.get_values().get(0), -3.0);
+    EXPECT_DOUBLE_EQ(a.get_values().get(3), 7.0);
+
+    Tensor x(fp16, 10), y(fp16, 2);
+    for (size_t j = 0; j < 10; ++j) x.set(j, 1.0 + j);
+    ASSERT_TRUE(spmv(a, x, y, AccumulatorConfig{Format{8, 23}}));
+    EXPECT_DOUBLE_EQ(y.get(0), -3.0 * 2 + 2.0 * 4 + 7.0 * 8 + 4.0 * 9 - 5.0 * 10);
+    EXPECT_DOUBLE_EQ(y.get(1), 1.0 * 1 + 1.0 * 2 + 9.0 * 5 - 8.0 * 7);
+}
+
+TEST(FPTest, Structured_Padding_Test) {
+    // 5 columns leave a trailing 2:4 group with a single column, so each row
+    // has a padding slot; an inf in x must not turn it into 0 * inf
+    Format fp16{5, 10};
+    const size_t rows = 4, cols = 5;
+    Tensor dense(fp16, {rows, cols});
+    double values[rows][cols] = {{1.0, 0.0, 2.0, 0.0,   0.5},
+                                 {0.0, 1.0, 0.0, -1.0,  2.0},
+                                 {0.0, 0.0, 0.0, 0.0,   -2.0},
+                                 {4.0, 0.0, 0.0, 0.0,   0.0}};
+    for (size_t r = 0; r < rows; ++r)
+        for (size_t c = 0; c < cols; ++c) dense.set(r * cols + c, values[r][c]);
+    StructuredSparseMatrix a(dense, 2, 4);
+    ASSERT_EQ(a.get_values().size(), rows * 2 * 2);
+
+    AccumulatorConfig config{Format{8, 23}};
+    for (size_t inf_col : {size_t(0), size_t(1), size_t(4)}) {
+        Tensor x(fp16, cols), y(fp16, rows);
+        std::vector<double> xv(cols);
+        for (size_t c = 0; c < cols; ++c) {
+            x.set(c, c == inf_col ? INFINITY : 1.0 + c);
+            xv[c] = x.get(c);
+        }
+        ASSERT_TRUE(spmv(a, x, y, config));
+        for (size_t r = 0; r < rows; ++r)
+            EXPECT_EQ(y.get_bits(r), encode(dense_mac(dense, r, xv, config), fp16)) << "row " << r << " inf at " << inf_col;
+
+        Tensor b(fp16, {cols, 1}), c(fp16, {rows, 1});
+        for (size_t k = 0; k < cols; ++k) b.set(k, x.get(k));
+        ASSERT_TRUE(spmm(a, b, c, config));
+        for (size_t r = 0; r < rows; ++r) EXPECT_EQ(c.get_bits(r), y.get_bits(r));
+    }
+}
+
+
+// ------------------------------------------------------------
+// 15. FFT Tests
+// ------------------------------------------------------------
+
+TEST(FPTest, Complex_Mul_Test) {
+    Format fp32{8, 23};
+    Complex a(fp32, 1.5, -2.0), b(fp32, 0.25, 3.0);
+    Complex p4 = mul(a, b, ComplexMul::four_mult);
+    Complex p3 = mul(a, b, ComplexMul::three_mult);
+    EXPECT_DOUBLE_EQ(p4.re, 1.5 * 0.25 + 2.0 * 3.0);
+    EXPECT_DOUBLE_EQ(p4.im, 1.5 * 3.0 - 2.0 * 0.25);
+    EXPECT_DOUBLE_EQ(p3.re, p4.re);   // exact in fp32 either way
+    EXPECT_DOUBLE_EQ(p3.im, p4.im);
+    EXPECT_DOUBLE_EQ((a + b).re, 1.75);
+    EXPECT_DOUBLE_EQ((a - b).im, -5.0);
+
+    // the Gauss form rounds intermediate sums, so in fp8 it may differ
+    Format fp8{4, 3};
+    Complex c(fp8, 1.125, 0.875), d(fp8, 0.9375, -1.25);
+    Complex q = mul(c, d, ComplexMul::three_mult);
+    EXPECT_EQ(q.get_format(), fp8);
+    EXPECT_EQ(q.get_real().get_raw_bits(), encode(q.re, fp8));
+}
+
+// naive DFT in double
+static void reference_dft(const std::vector<double>& xr, const std::vector<double>& xi,
+                          std::vector<double>& yr, std::vector<double>& yi, bool inverse) {
+    size_t n = xr.size();
+    const double pi = std::acos(-1.0);
+    yr.assign(n, 0.0);
+    yi.assign(n, 0.0);
+    for (size_t k = 0; k < n; ++k) {
+        for (size_t t = 0; t < n; ++t) {
+            double angle = (inverse ? 2.0 : -2.0) * pi * double(k * t % n) / double(n);
+            yr[k] += xr[t] * std::cos(angle) - xi[t] * std::sin(angle);
+            yi[k] += xr[t] * std::sin(angle) + xi[t] * std::cos(angle);
+        }
+    }
+}
+
+// largest componentwise error of plan output against the reference DFT
+static double fft_error(const FFTPlan& plan, const std::vector<double>& xr, const std::vector<double>& xi) {
+    size_t n = xr.size();
+    Tensor re(plan.get_format(), n), im(plan.get_format(), n);
+    re.encode_range(0, n, xr.data());
+    im.encode_range(0, n, xi.data());
+    std::vector<double> rr(n), ri(n), yr, yi;
+    re.decode_range(0, n, rr.data());
+    im.decode_range(0, n, ri.data());
+    reference_dft(rr, ri, yr, yi, false);
+    EXPECT_TRUE(plan.execute(re, im));
+    double error = 0.0;
+    for (size_t k = 0; k < n; ++k) {
+        error = std::max(error, std::abs(re.get(k) - yr[k]));
+        error = std::max(error, std::abs(im.get(k) - yi[k]));
+    }
+    return error;
+}
+
+TEST(FPTest, FFT_Accuracy_Test) {
+    Format fp64{11, 52}, fp32{8, 23}, fp16{5, 10};
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    for (size_t n : {1u, 2u, 8u, 32u, 128u}) {
+        std::vector<double> xr(n), xi(n);
+        for (size_t i = 0; i < n; ++i) {
+            xr[i] = dist(rng);
+            xi[i] = dist(rng);
+        }
+        EXPECT_LT(fft_error(FFTPlan(n, fp64, false, FFTRadix::radix2), xr, xi), 1e-12);
+        EXPECT_LT(fft_error(FFTPlan(n, fp64, false, FFTRadix::radix4), xr, xi), 1e-12);
+        EXPECT_LT(fft_error(FFTPlan(n, fp64, false, FFTRadix::radix4, ComplexMul::three_mult), xr, xi), 1e-12);
+        if (n >= 32) {
+            double e32 = fft_error(FFTPlan(n, fp32), xr, xi);
+            double e16 = fft_error(FFTPlan(n, fp16), xr, xi);
+            EXPECT_LT(e32, 1e-4);
+            EXPECT_LT(e16, 0.5);
+            EXPECT_GT(e16, e32);
+        }
+    }
+}
+
+TEST(FPTest, FFT_Batch_Roundtrip_Test) {
+    Format fp32{8, 23};
+    const size_t n = 64, batch = 5;
+    Tensor re(fp32, n * batch), im(fp32, n * batch);
+    std::mt19937 rng(9);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    for (size_t i = 0; i < re.size(); ++i) {
+        re.set(i, dist(rng));
+        im.set(i, dist(rng));
+    }
+    Tensor orig_re = re, orig_im = im;
+
+    FFTPlan forward(n, fp32), inverse(n, fp32, true);
+    ASSERT_TRUE(forward.execute(re, im, batch));
+    for (size_t b = 0; b < batch; ++b) {
+        Tensor single_re(fp32, n), single_im(fp32, n);
+        for (size_t i = 0; i < n; ++i) {
+            single_re.set_bits(i, orig_re.get_bits(b * n + i));
+            single_im.set_bits(i, orig_im.get_bits(b * n + i));
+        }
+        ASSERT_TRUE(forward.execute(single_re, single_im));
+        for (size_t i = 0; i < n; ++i) {
+            EXPECT_EQ(re.get_bits(b * n + i), single_re.get_bits(i));
+            EXPECT_EQ(im.get_bits(b * n + i), single_im.get_bits(i));
+        }
+    }
+
+    // the inverse is unnormalized
+    ASSERT_TRUE(inverse.execute(re, im, batch));
+    for (size_t i = 0; i < re.size(); ++i) {
+        EXPECT_NEAR(re.get(i) / n, orig_re.get(i), 1e-5);
+        EXPECT_NEAR(im.get(i) / n, orig_im.get(i), 1e-5);
+    }
+
+    FFTPlan bad(12, fp32);
+    EXPECT_FALSE(bad.is_valid());
+    Tensor r12(fp32, 12), i12(fp32, 12);
+    EXPECT_FALSE(bad.execute(r12, i12));
+    EXPECT_FALSE(forward.execute(re, im, batch + 1));
+}
+
+
+// ------------------------------------------------------------
+// 16. Solver Tests
+// ------------------------------------------------------------
+
+TEST(FPTest, CG_Poisson_Test) {
+    // 1D Poisson matrix with a known solution
+    const size_t n = 256;
+    Format fp64{11, 52}, fp32{8, 23}, fp16{5, 10};
+    std::vector<CsrMatrix::Triplet> entries;
+    for (size_t i = 0; i < n; ++i) {
+        entries.push_back({i, i, 2.0 + 0.01 * (i % 7)});
+        if (i > 0) entries.push_back({i, i - 1, -1.0});
+        if (i + 1 < n) entries.push_back({i, i + 1, -1.0});
+    }
+    CsrMatrix a(fp64, n, n, entries);
+    std::vector<double> solution(n);
+    Tensor b(fp64, n);
+    for (size_t i = 0; i < n; ++i) solution[i] = std::sin(0.05 * i);
+    for (size_t i = 0; i < n; ++i) {
+        double v = (2.0 + 0.01 * (i % 7)) * solution[i];
+        if (i > 0) v -= solution[i - 1];
+        if (i + 1 < n) v -= solution[i + 1];
+        b.set(i, v);
+    }
+
+    SolverConfig config;
+    config.matvec = config.dot = config.update = config.precond = fp64;
+    config.tolerance = 1e-10;
+    Tensor x(fp64, n);
+    SolverResult result;
+    ASSERT_TRUE(conjugate_gradient(a, b, x, result, config));
+    EXPECT_TRUE(result.converged);
+    EXPECT_EQ(result.residual_history.size(), result.iterations + 1);
+    EXPECT_LE(result.iterations, n);
+    for (size_t i = 0; i < n; ++i) EXPECT_NEAR(x.get(i), solution[i], 1e-7);
+
+    // low-precision preconditioner with fp32 kernels still converges
+    config.matvec = config.dot = config.update = fp32;
+    config.precond = fp16;
+    config.tolerance = 1e-4;
+    Tensor x32(fp32, n);
+    ASSERT_TRUE(conjugate_gradient(a, b, x32, result, config));
+    EXPECT_TRUE(result.converged);
+    for (size_t i = 0; i < n; ++i) EXPECT_NEAR(x32.get(i), solution[i], 1e-2);
+
+    std::ostringstream csv;
+    write_residual_history(csv, result);
+    std::string text = csv.str();
+    EXPECT_EQ(static_cast<size_t>(std::count(text.begin(), text.end(), '\n')),
+              result.residual_history.size() + 1);
+
+    Tensor wrong(fp64, n + 1);
+    EXPECT_FALSE(conjugate_gradient(a, wrong, x, result, config));
+}
+
+TEST(FPTest, IterativeRefinement_Test) {
+    const size_t n = 48;
+    Format fp64{11, 52}, fp16{5, 10};
+    Tensor a(fp64, {n, n}), b(fp64, n);
+    std::mt19937 rng(21);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    for (size_t i = 0; i < n; ++i)
+        for (size_t j = 0; j < n; ++j) a.set(i * n + j, dist(rng) + (i == j ? 8.0 : 0.0));
+    for (size_t i = 0; i < n; ++i) b.set(i, dist(rng));
+
+    SolverConfig config;
+    config.factor = fp16;
+    config.update = fp64;
+    config.residual = fp64;
+    config.tolerance = 1e-12;
+    config.max_iterations = 50;
+    Tensor x(fp64, n);
+    SolverResult result;
+    ASSERT_TRUE(iterative_refinement(a, b, x, result, config));
+    EXPECT_TRUE(result.converged);
+    EXPECT_GT(result.residual_history.front(), 1e-5);   // fp16 factors alone
+    EXPECT_LE(result.residual_history.back(), 1e-12);
+    EXPECT_GT(result.iterations, 1u);
+
+    Tensor singular(fp64, {2, 2}), rhs(fp64, 2), out(fp64, 2);
+    EXPECT_FALSE(iterative_refinement(singular, rhs, out, result, config));
+    Tensor vector_a(fp64, 4);
+    EXPECT_FALSE(iterative_refinement(vector_a, rhs, out, result, config));
+}
+
+
+// ------------------------------------------------------------
+// 17. Transformer Tests
+// ------------------------------------------------------------
+
+static void fill_uniform(Tensor& t, std::mt19937& rng, double lo, double hi) {
+    std::uniform_real_distribution<double> dist(lo, hi);
+    for (size_t i = 0; i < t.size(); ++i) t.set(i, dist(rng));
+}
+
+TEST(FPTest, Softmax_Test) {
+    Format fp64{11, 52}, fp16{5, 10}, fp8{4, 3};
+    const size_t rows = 37, cols = 50;
+    std::mt19937 rng(3);
+    Tensor x(fp16, {rows, cols}), out(fp64, {rows, cols});
+    fill_uniform(x, rng, -8.0, 8.0);
+    x.set(0, 60000.0);   // exp would overflow without the max subtraction
+
+    SoftmaxConfig exact{fp64, fp64};
+    ASSERT_TRUE(softmax(x, out, exact));
+    for (size_t r = 0; r < rows; ++r) {
+        double max = -INFINITY, sum = 0.0;
+        for (size_t c = 0; c < cols; ++c) max = std::max(max, x.get(r * cols + c));
+        for (size_t c = 0; c < cols; ++c) sum += std::exp(x.get(r * cols + c) - max);
+        for (size_t c = 0; c < cols; ++c)
+            EXPECT_NEAR(out.get(r * cols + c), std::exp(x.get(r * cols + c) - max) / sum, 1e-12);
+    }
+    EXPECT_DOUBLE_EQ(out.get(0), 1.0);
+
+    // low-precision exponentials change the weights; the reciprocal form rounds once more
+    Tensor low(fp64, {rows, cols}), low_reciprocal(fp64, {rows, cols});
+    SoftmaxConfig narrow{fp8, fp16};
+    ASSERT_TRUE(softmax(x, low, narrow));
+    narrow.reciprocal = true;
+    ASSERT_TRUE(softmax(x, low_reciprocal, narrow));
+    double difference = 0.0, reciprocal_difference = 0.0;
+    for (size_t i = 0; i < out.size(); ++i) {
+        difference = std::max(difference, std::abs(low.get(i) - out.get(i)));
+        reciprocal_difference = std::max(reciprocal_difference, std::abs(low_reciprocal.get(i) - low.get(i)));
+    }
+    EXPECT_GT(difference, 1e-4);
+    EXPECT_LT(difference, 0.1);
+    EXPECT_GT(reciprocal_difference, 0.0);
+
+    Tensor wrong(fp64, rows);
+    EXPECT_FALSE(softmax(x, wrong));
+}
+
+TEST(FPTest, Norm_Activation_Test) {
+    Format fp64{11, 52}, fp32{8, 23}, bf16{8, 7};
+    const size_t rows = 9, cols = 64;
+    std::mt19937 rng(4);
+    Tensor x(fp32, {rows, cols}), gamma(fp32, cols), beta(fp32, cols), out(fp64, {rows, cols});
+    fill_uniform(x, rng, -3.0, 5.0);
+    fill_uniform(gamma, rng, 0.5, 1.5);
+    fill_uniform(beta, rng, -0.5, 0.5);
+
+    NormConfig exact{fp64, fp64, fp64, 1e-5};
+    ASSERT_TRUE(layer_norm(x, gamma, beta, out, exact));
+    Tensor rms(fp64, {rows, cols});
+    ASSERT_TRUE(rms_norm(x, gamma, rms, exact));
+    for (size_t r = 0; r < rows; ++r) {
+        double mean = 0.0, var = 0.0, ms = 0.0;
+        for (size_t c = 0; c < cols; ++c) mean += x.get(r * cols + c) / cols;
+        for (size_t c = 0; c < cols; ++c) {
+            double d = x.get(r * cols + c) - mean;
+            var += d * d / cols;
+            ms += x.get(r * cols + c) * x.get(r * cols + c) / cols;
+        }
+        for (size_t c = 0; c < cols; ++c) {
+            double v = x.get(r * cols + c);
+            EXPECT_NEAR(out.get(r * cols + c), (v - mean) / std::sqrt(var + 1e-5) * gamma.get(c) + beta.get(c), 1e-10);
+            EXPECT_NEAR(rms.get(r * cols + c), v / std::sqrt(ms + 1e-5) * gamma.get(c), 1e-10);
+        }
+    }
+
+    // bf16 statistics stay within bf16 resolution of the exact result
+    Tensor narrow(fp64, {rows, cols});
+    ASSERT_TRUE(layer_norm(x, gamma, beta, narrow, NormConfig{fp32, bf16}));
+    for (size_t i = 0; i < out.size(); ++i) EXPECT_NEAR(narrow.get(i), out.get(i), 0.05);
+    EXPECT_FALSE(layer_norm(x, beta, Tensor(fp32, cols + 1), out));
+
+    Tensor a(fp32, 1000), gelu(fp64, 1000), gelu_tanh(fp64, 1000), silu(fp64, 1000);
+    fill_uniform(a, rng, -6.0, 6.0);
+    ActivationConfig precise{fp64, fp64};
+    ASSERT_TRUE(activation(a, gelu, Activation::gelu_erf, precise));
+    ASSERT_TRUE(activation(a, gelu_tanh, Activation::gelu_tanh, precise));
+    ASSERT_TRUE(activation(a, silu, Activation::silu, precise));
+    for (size_t i = 0; i < a.size(); ++i) {
+        double v = a.get(i);
+        EXPECT_NEAR(gelu.get(i), 0.5 * v * (1.0 + std::erf(v / std::sqrt(2.0))), 1e-12);
+        EXPECT_NEAR(gelu_tanh.get(i), gelu.get(i), 1e-3);
+        EXPECT_NEAR(silu.get(i), v / (1.0 + std::exp(-v)), 1e-12);
+    }
+    Tensor narrow_silu(fp64, 1000);
+    ASSERT_TRUE(activation(a, narrow_silu, Activation::silu, ActivationConfig{bf16}));
+    EXPECT_NE(narrow_silu.get_bits(1), silu.get_bits(1));
+
+    // the epilogue is its own rounding point: with exact intermediates every
+    // result lands on the bf16 grid
+    ActivationConfig narrow_epilogue{fp64, bf16};
+    for (Activation kind : {Activation::gelu_erf, Activation::gelu_tanh, Activation::silu}) {
+        Tensor rounded(fp64, 1000);
+        ASSERT_TRUE(activation(a, rounded, kind, narrow_epilogue));
+        for (size_t i = 0; i < a.size(); ++i)
+            EXPECT_EQ(rounded.get(i), round_value(rounded.get(i), bf16)) << "kind " << static_cast<int>(kind);
+    }
+    Tensor affine(fp64, {rows, cols}), affine_rms(fp64, {rows, cols});
+    NormConfig narrow_affine{fp64, fp64, bf16, 1e-5};
+    ASSERT_TRUE(layer_norm(x, gamma, beta, affine, narrow_affine));
+    ASSERT_TRUE(rms_norm(x, gamma, affine_rms, narrow_affine));
+    for (size_t i = 0; i < affine.size(); ++i) {
+        EXPECT_EQ(affine.get(i), round_value(affine.get(i), bf16));
+        EXPECT_EQ(affine_rms.get(i), round_value(affine_rms.get(i), bf16));
+        EXPECT_NEAR(affine.get(i), out.get(i), 0.05);
+    }
+}
+
+TEST(FPTest, Attention_Test) {
+    Format fp64{11, 52}, fp16{5, 10};
+    const size_t heads = 3, seq = 17, d = 8, dv = 5;
+    std::mt19937 rng(8);
+    Tensor q(fp16, {heads, seq, d}), k(fp16, {heads, seq, d}), v(fp16, {heads, seq, dv});
+    fill_uniform(q, rng, -2.0, 2.0);
+    fill_uniform(k, rng, -2.0, 2.0);
+    fill_uniform(v, rng, -1.0, 1.0);
+
+    AttentionConfig exact{fp64, fp64, SoftmaxConfig{fp64, fp64}, fp64, fp64};
+    for (bool causal : {false, true}) {
+        exact.causal = causal;
+        Tensor out(fp64, {heads, seq, dv});
+        ASSERT_TRUE(attention(q, k, v, out, exact));
+        for (size_t h = 0; h < heads; ++h) {
+            for (size_t i = 0; i < seq; ++i) {
+                size_t visible = causal ? i + 1 : seq;
+                std::vector<double> s(visible);
+                double max = -INFINITY, sum = 0.0;
+                for (size_t j = 0; j < visible; ++j) {
+                    double dot = 0.0;
+                    for (size_t c = 0; c < d; ++c) dot += q.get((h * seq + i) * d + c) * k.get((h * seq + j) * d + c);
+                    s[j] = dot / std::sqrt(double(d));
+                    max = std::max(max, s[j]);
+                }
+                for (double& value : s) sum += (value = std::exp(value - max));
+                for (size_t c = 0; c < dv; ++c) {
+                    double expected = 0.0;
+                    for (size_t j = 0; j < visible; ++j) expected += s[j] / sum * v.get((h * seq + j) * dv + c);
+                    EXPECT_NEAR(out.get((h * seq + i) * dv + c), expected, 1e-12);
+                }
+            }
+        }
+        if (causal) {
+            for (size_t c = 0; c < dv; ++c) EXPECT_DOUBLE_EQ(out.get(c), v.get(c));
+        }
+    }
+
+    // a single head through the 2-D form matches the batched result bit for bit
+    AttentionConfig low{Format{8, 23}, fp16, SoftmaxConfig{fp16, Format{8, 23}}, fp16, Format{8, 23}};
+    Tensor batched(fp16, {heads, seq, dv});
+    ASSERT_TRUE(attention(q, k, v, batched, low));
+    Tensor q1(fp16, {seq, d}), k1(fp16, {seq, d}), v1(fp16, {seq, dv}), out1(fp16, {seq, dv});
+    for (size_t i = 0; i < seq * d; ++i) {
+        q1.set_bits(i, q.get_bits(2 * seq * d + i));
+        k1.set_bits(i, k.get_bits(2 * seq * d + i));
+    }
+    for (size_t i = 0; i < seq * dv; ++i) v1.set_bits(i, v.get_bits(2 * seq * dv + i));
+    ASSERT_TRUE(attention(q1, k1, v1, out1, low));
+    for (size_t i = 0; i < seq * dv; ++i) EXPECT_EQ(out1.get_bits(i), batched.get_bits(2 * seq * dv + i));
+
+    Tensor wrong(fp16, {heads, seq, dv + 1});
+    EXPECT_FALSE(attention(q, k, v, wrong, low));
+}
+
+
+// ------------------------------------------------------------
+// 18. Executor Tests
+// ------------------------------------------------------------
+
+TEST(FPTest, Stateless_Operators_Test) {
+    ExMy a(1, 5, 10), b(1, 5, 10);
+    a.set_bits(encode(3.5, Format{5, 10}));
+    b.set_bits(encode(1.25, Format{5, 10}));
+    const ExMy ca = a, cb = b;
+
+    // operators run on const inputs and leave them untouched
+    const Adder adder;
+    const Subtractor subtractor;
+    ExMy sum(1, 5, 10), difference(1, 5, 10);
+    EXPECT_TRUE(adder.add(&ca, &cb, &sum));
+    EXPECT_TRUE(subtractor.subtract(&ca, &cb, &difference));
+    EXPECT_EQ(ca.get_raw_bits(), a.get_raw_bits());
+    EXPECT_EQ(cb.get_raw_bits(), b.get_raw_bits());
+
+    // value-returning forms match the pointer forms
+    EXPECT_EQ((ca + cb).get_raw_bits(), sum.get_raw_bits());
+    EXPECT_EQ((ca - cb).get_raw_bits(), difference.get_raw_bits());
+    ExMy minus_b = cb;
+    minus_b.sign = 1;
+    EXPECT_EQ((ca - cb).get_raw_bits(), add(ca, minus_b).get_raw_bits());
+    ExMy product(1, 5, 10);
+    Multiplier().mul(&ca, &cb, &product);
+    EXPECT_EQ(multiply(ca, cb).get_raw_bits(), product.get_raw_bits());
+
+    // rejected operands give a NaN in a's format
+    ExMy other(1, 8, 23);
+    other.set_bits(encode(2.0, Format{8, 23}));
+    for (const ExMy& invalid : {add(ca, other), subtract(ca, other), multiply(ca, other), divide(ca, other)}) {
+        EXPECT_EQ(invalid.get_flag(), ExMy::FP_status::NaN);
+        EXPECT_EQ(invalid.get_format(), ca.get_format());
+    }
+    ExMy untouched(1, 5, 10);
+    EXPECT_FALSE(Multiplier().mul(&ca, &other, &untouched));
+}
+
+TEST(FPTest, Special_Operands_Test) {
+    ExMy pos_inf(1, 5, 10), neg_inf(1, 5, 10), one(1, 5, 10), nan(1, 5, 10);
+    pos_inf.set_bits(0x7C00);
+    neg_inf.set_bits(0xFC00);
+    one.set_bits(0x3C00);
+    nan.set_bits(0x7E01);
+
+    // the result object's previous contents never leak into the result
+    for (unsigned long long held : {0x0000ULL, 0xBC00ULL, 0x7C00ULL, 0xFC00ULL}) {
+        ExMy result(1, 5, 10);
+        result.set_bits(held);
+        Adder().add(&neg_inf, &one, &result);
+        EXPECT_EQ(result.get_raw_bits(), 0xFC00u);
+        result.set_bits(held);
+        Adder().add(&one, &pos_inf, &result);
+        EXPECT_EQ(result.get_raw_bits(), 0x7C00u);
+        result.set_bits(held);
+        Subtractor().subtract(&pos_inf, &pos_inf, &result);
+        EXPECT_EQ(result.get_flag(), ExMy::FP_status::NaN);
+        result.set_bits(held);
+        Adder().add(&pos_inf, &neg_inf, &result);
+        EXPECT_EQ(result.get_flag(), ExMy::FP_status::NaN);
+        result.set_bits(held);
+        Adder().add(&one, &nan, &result);
+        EXPECT_EQ(result.get_flag(), ExMy::FP_status::NaN);
+        result.set_bits(held);
+        Subtractor().subtract(&nan, &one, &result);
+        EXPECT_EQ(result.get_flag(), ExMy::FP_status::NaN);
+    }
+
+    EXPECT_EQ((neg_inf + one).get_raw_bits(), 0xFC00u);
+    EXPECT_EQ(add(one, neg_inf).get_raw_bits(), 0xFC00u);
+    EXPECT_EQ((one - neg_inf).get_raw_bits(), 0x7C00u);
+    EXPECT_EQ((pos_inf - pos_inf).get_flag(), ExMy::FP_status::NaN);
+    EXPECT_EQ((neg_inf + pos_inf).get_flag(), ExMy::FP_status::NaN);
+    EXPECT_EQ((nan + one).get_flag(), ExMy::FP_status::NaN);
+    EXPECT_EQ((one - nan).get_flag(), ExMy::FP_status::NaN);
+    EXPECT_EQ((nan + pos_inf).get_flag(), ExMy::FP_status::NaN);
+}
+
+TEST(FPTest, Divide_Test) {
+    Format fp16{5, 10};
+    auto value = [&](double v) {
+        ExMy x(1, 5, 10);
+        x.set_bits(encode(v, fp16));
+        return x;
+    };
+
+    // divisors with an empty mantissa field, i.e. powers of two
+    EXPECT_DOUBLE_EQ((value(3.0) / value(2.0)).approximation(), 1.5);
+    EXPECT_DOUBLE_EQ((value(-5.0) / value(0.25)).approximation(), -20.0);
+    EXPECT_DOUBLE_EQ((value(1.0) / value(1024.0)).approximation(), 1.0 / 1024.0);
+
+    // the quotient is truncated, which matches rounding toward zero
+    std::mt19937 rng(35);
+    std::uniform_real_distribution<double> dist(-8.0, 8.0);
+    for (int i = 0; i < 2000; ++i) {
+        ExMy x = value(dist(rng)), y = value(dist(rng));
+        if (y.get_flag() == ExMy::FP_status::zero) continue;
+        double exact = decode(x.get_raw_bits(), fp16) / decode(y.get_raw_bits(), fp16);
+        EXPECT_EQ(divide(x, y).get_raw_bits(), encode(exact, fp16, RoundingMode::toward_zero));
+    }
+
+    // subnormal results and operands
+    EXPECT_DOUBLE_EQ(decode((value(std::ldexp(1.0, -14)) / value(4.0)).get_raw_bits(), fp16), std::ldexp(1.0, -16));
+    EXPECT_DOUBLE_EQ((value(std::ldexp(3.0, -20)) / value(std::ldexp(1.0, -20))).approximation(), 3.0);
+
+    // special operands
+    EXPECT_EQ((value(1.0) / value(0.0)).get_flag(), ExMy::FP_status::inf);
+    EXPECT_EQ((value(-1.0) / value(0.0)).sign, 1u);
+    EXPECT_EQ((value(0.0) / value(0.0)).get_flag(), ExMy::FP_status::NaN);
+    EXPECT_EQ((value(INFINITY) / value(INFINITY)).get_flag(), ExMy::FP_status::NaN);
+    EXPECT_EQ((value(2.0) / value(INFINITY)).get_flag(), ExMy::FP_status::zero);
+    EXPECT_EQ((value(60000.0) / value(0.5)).get_flag(), ExMy::FP_status::inf);
+
+    // over packed buffers
+    const size_t n = 4096;
+    Tensor a(fp16, n), b(fp16, n), out(fp16, n);
+    for (size_t i = 0; i < n; ++i) {
+        a.set(i, static_cast<double>(i % 61) - 30.0);
+        b.set(i, std::ldexp(1.0, static_cast<int>(i % 7) - 3));
+    }
+    ThreadPool pool(4);
+    ASSERT_TRUE(parallel_transform(a, b, out, [](const ExMy& x, const ExMy& y) { return x / y; }, pool));
+    for (size_t i = 0; i < n; ++i) EXPECT_DOUBLE_EQ(out.get(i), a.get(i) / b.get(i));
+
+    // rejected operands in a format without mantissa bits
+    ExMy narrow(1, 4, 0), other(1, 5, 10);
+    narrow.set_bits(encode(2.0, Format{4, 0}));
+    EXPECT_EQ(divide(narrow, other).get_format(), narrow.get_format());
+}
+
+TEST(FPTest, Parallel_Transform_Test) {
+    Format fp16{5, 10};
+    const size_t n = 20000;
+    Tensor a(fp16, n), b(fp16, n), out(fp16, n), widened(Format{8, 23}, n);
+    std::mt19937 rng(12);
+    std::uniform_real_distribution<double> dist(0.5, 4.0);
+    for (size_t i = 0; i < n; ++i) {
+        a.set(i, dist(rng));
+        b.set(i, dist(rng));
+    }
+
+    ThreadPool pool(4);
+    AutoGrain tuner(64);
+    auto sum = [](const ExMy& x, const ExMy& y) { return x + y; };
+    for (int call = 0; call < 8; ++call)
+        ASSERT_TRUE(parallel_transform(a, b, out, sum, pool, &tuner));
+    for (size_t i = 0; i < n; ++i)
+        EXPECT_EQ(out.get_bits(i), add(a.get_exmy(i), b.get_exmy(i)).get_raw_bits());
+
+    // results in another format are rounded into out's format
+    ASSERT_TRUE(parallel_transform(a, widened, [](const ExMy& x) { return x; }, pool));
+    for (size_t i = 0; i < n; i += 97) EXPECT_DOUBLE_EQ(widened.get(i), a.get(i));
+    EXPECT_FALSE(parallel_transform(a, Tensor(fp16, n + 1), out, sum, pool));
+}
+
+TEST(FPTest, AutoGrain_Test) {
+    // synthetic throughput peaking at a grain of 4096
+    AutoGrain tuner(256, 16, 1 << 16);
+    auto rate = [](size_t grain) {
+        double distance = std::abs(std::log2(static_cast<double>(grain)) - 12.0);
+        return 1e9 / (1.0 + distance);
+    };
+    for (int call = 0; call < 64 && !tuner.is_settled(); ++call) {
+        size_t grain = tuner.next_grain();
+        tuner.record(grain, 1000000, 1000000 / rate(grain));
+    }
+    EXPECT_TRUE(tuner.is_settled());
+    EXPECT_EQ(tuner.get_grain(), 4096u);
+    EXPECT_EQ(tuner.next_grain(), 4096u);
+
+    // starting above the peak, the tuner turns around and halves
+    AutoGrain high(1 << 15, 16, 1 << 16);
+    for (int call = 0; call < 64 && !high.is_settled(); ++call) {
+        size_t grain = high.next_grain();
+        high.record(grain, 1000000, 1000000 / rate(grain));
+    }
+    EXPECT_EQ(high.get_grain(), 4096u);
+}
+
+TEST(FPTest, ThreadPool_Pinning_Test) {
+    ThreadPool pool(3, true);
+#ifdef __linux__
+    EXPECT_TRUE(pool.is_pinned());
+#endif
+    std::atomic<size_t> total{0};
+    pool.parallel_for(0, 10000, 100, [&](size_t first, size_t last) { total += last - first; });
+    EXPECT_EQ(total.load(), 10000u);
+    EXPECT_FALSE(ThreadPool(2).is_pinned());
+    EXPECT_FALSE(ThreadPool(1, true).is_pinned());   // the caller alone is never pinned
+}
@@ -0,0 +1,73 @@
+#include "Sweep.hpp"
+#include <iostream>
+#include <sstream>
+
+using namespace CustomFP;
+
+// usage: flexfloat_sweep <workload> [--inputs e4m3,e5m2] [--accumulators e8m23]
+//                        [--modes rne,rtz] [--threads N]
+// prints the error vs. cost table as CSV on stdout
+
+static std::vector<std::string> split(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) items.push_back(item);
+    return items;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0]
+                  << " <workload> [--inputs e4m3,...] [--accumulators e8m23,...] [--modes rne,...] [--threads N]\n";
+        return 1;
+    }
+
+    std::vector<Format> inputs = {{4, 3}, {5, 2}, {5, 10}, {8, 7}};
+    std::vector<Format> accumulators = {{5, 10}, {8, 23}};
+    std::vector<RoundingMode> modes = {RoundingMode::nearest_even};
+    unsigned threads = 0;
+
+    for (int i = 2; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        std::string value = argv[i + 1];
+        if (flag == "--inputs" || flag == "--accumulators") {
+            auto& target = flag == "--inputs" ? inputs : accumulators;
+            target.clear();
+            for (const auto& name : split(value)) {
+                Format format{};
+                if (!parse_format(name, format)) {
+                    std::cerr << "bad format: " << name << "\n";
+                    return 1;
+                }
+                target.push_back(format);
+            }
+        } else if (flag == "--modes") {
+            modes.clear();
+            for (const auto& name : split(value)) {
+                RoundingMode mode;
+                if (!parse_rounding(name, mode)) {
+                    std::cerr << "bad rounding mode: " << name << "\n";
+                    return 1;
+                }
+                modes.push_back(mode);
+            }
+        } else if (flag == "--threads") {
+            threads = static_cast<unsigned>(std::stoul(value));
+        } else {
+            std::cerr << "unknown option: " << flag << "\n";
+            return 1;
+        }
+    }
+
+    Workload workload;
+    if (!load_workload(std::string(argv[1]), workload)) {
+        std::cerr << "cannot load workload: " << argv[1] << "\n";
+        return 1;
+    }
+
+    ThreadPool pool(threads);
+    auto results = run_sweep(workload, make_grid(inputs, accumulators, modes), pool);
+    write_table(std::cout, results);
+    return 0;
+}